@@ -0,0 +1,178 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    capture_queue.h
+  \brief   C++ Interface: CaptureQueue
+*/
+//========================================================================
+
+#ifndef CAPTURE_QUEUE_H
+#define CAPTURE_QUEUE_H
+#include <QMutex>
+#include <QWaitCondition>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include "rawimage.h"
+
+/*!
+  \class   CaptureQueue
+  \brief   A bounded hand-off queue between an acquisition and a processing thread
+
+  The queue owns a fixed number of slots, each holding a converted RawImage.
+  The acquisition thread takes a free slot, fills it and commits it.
+  The processing thread takes the oldest filled slot, swaps its image into
+  the FrameBuffer, and recycles the slot (which now holds the buffer that
+  was previously owned by the FrameBuffer). No image data is ever copied.
+
+  If the processing thread falls behind and no free slot is left, the
+  acquisition thread reuses the oldest filled slot. The frame held there is
+  counted as dropped, so we always process the most recent frames.
+
+  The queue needs at least 2 slots: one for each thread.
+*/
+class CaptureQueue {
+  public:
+  class Slot {
+    public:
+    RawImage image;
+    double time;
+    std::chrono::steady_clock::time_point t_start;
+    std::chrono::steady_clock::time_point t_get_frame;
+    std::chrono::steady_clock::time_point t_convert;
+    Slot() {
+      time=0.0;
+    }
+  };
+
+  protected:
+  QMutex mutex;
+  QWaitCondition filled_cond;
+  std::vector<Slot> items;
+  std::deque<int> free_slots;
+  std::deque<int> filled_slots;
+  long long dropped;
+  long long committed;
+
+  public:
+  CaptureQueue(int depth) {
+    if (depth < 2) depth=2;
+    items.resize(depth);
+    for (int i=0;i<depth;i++) {
+      free_slots.push_back(i);
+    }
+    dropped=0;
+    committed=0;
+  }
+
+  ~CaptureQueue() {
+    for (unsigned int i=0;i<items.size();i++) {
+      items[i].image.clear();
+    }
+  }
+
+  int getDepth() const {
+    return (int)items.size();
+  }
+
+  Slot * getSlot(int idx) {
+    return &(items[idx]);
+  }
+
+  /// returns a slot for the acquisition thread to write to.
+  /// never blocks: if no slot is free, the oldest filled slot is dropped.
+  int acquireFree() {
+    int idx=-1;
+    mutex.lock();
+    if (free_slots.empty()==false) {
+      idx=free_slots.front();
+      free_slots.pop_front();
+    } else if (filled_slots.empty()==false) {
+      idx=filled_slots.front();
+      filled_slots.pop_front();
+      dropped++;
+    }
+    mutex.unlock();
+    return idx;
+  }
+
+  /// hands a filled slot over to the processing thread
+  void commit(int idx) {
+    mutex.lock();
+    filled_slots.push_back(idx);
+    committed++;
+    mutex.unlock();
+    filled_cond.wakeOne();
+  }
+
+  /// returns a slot to the free list without processing it
+  /// (used for failed conversions and by the processing thread
+  /// after it swapped the image out)
+  void recycle(int idx) {
+    mutex.lock();
+    free_slots.push_back(idx);
+    mutex.unlock();
+  }
+
+  /// returns the oldest filled slot, or -1 if none became
+  /// available within \p timeout_ms milliseconds
+  int waitFilled(unsigned long timeout_ms) {
+    int idx=-1;
+    mutex.lock();
+    if (filled_slots.empty()) {
+      filled_cond.wait(&mutex,timeout_ms);
+    }
+    if (filled_slots.empty()==false) {
+      idx=filled_slots.front();
+      filled_slots.pop_front();
+    }
+    mutex.unlock();
+    return idx;
+  }
+
+  /// moves all pending frames back to the free list, counting them as dropped
+  void flush() {
+    mutex.lock();
+    while (filled_slots.empty()==false) {
+      free_slots.push_back(filled_slots.front());
+      filled_slots.pop_front();
+      dropped++;
+    }
+    mutex.unlock();
+  }
+
+  int getPending() {
+    mutex.lock();
+    int res=(int)filled_slots.size();
+    mutex.unlock();
+    return res;
+  }
+
+  long long getDropped() {
+    mutex.lock();
+    long long res=dropped;
+    mutex.unlock();
+    return res;
+  }
+
+  long long getCommitted() {
+    mutex.lock();
+    long long res=committed;
+    mutex.unlock();
+    return res;
+  }
+};
+
+#endif
@@ -23,6 +23,7 @@
 #include <capture_splitter.h>
 #include <iostream>
 #include <iomanip>
+#include <utility>
 
 CaptureThread::CaptureThread(int cam_id)
 {
@@ -38,13 +39,20 @@ CaptureThread::CaptureThread(int cam_id)
   // timings should only be printed on demand for a short period of time by temporally activating this flag
   control->addChild( (VarType*) (c_print_timings = new VarBool("print timings",false)));
   control->addChild( (VarType*) (c_refresh= new VarTrigger("re-read params","Refresh")));
+  // grab the next frame on a separate thread while the stack processes the current one
+  control->addChild( (VarType*) (c_pipelined = new VarBool("pipelined capture",false)));
+  control->addChild( (VarType*) (c_queue_depth = new VarInt("pipeline queue depth",2,2,16)));
+  // let drivers lend their own buffers to the frame instead of copying them
+  control->addChild( (VarType*) (c_zero_copy = new VarBool("zero-copy frames",true)));
   control->addChild( (VarType*) (captureModule= new VarStringEnum("Capture Module","None")));
   captureModule->addFlags(VARTYPE_FLAG_NOLOAD_ENUM_CHILDREN);
   captureModule->addItem("None");
   captureModule->addItem("Read from files");
   captureModule->addItem("Generator");
+  captureModule->addItem("Read from raw video");
   settings->addChild( (VarType*) (fromfile = new VarList("Read from files")));
   settings->addChild( (VarType*) (generator = new VarList("Generator")));
+  settings->addChild( (VarType*) (rawvideo = new VarList("Read from raw video")));
   settings->addFlags( VARTYPE_FLAG_AUTO_EXPAND_TREE );
   c_stop->addFlags( VARTYPE_FLAG_READONLY );
   c_refresh->addFlags( VARTYPE_FLAG_READONLY );
@@ -58,6 +66,7 @@ CaptureThread::CaptureThread(int cam_id)
   capture=nullptr;
   captureFiles = new CaptureFromFile(fromfile, camId);
   captureGenerator = new CaptureGenerator(generator);
+  captureRawVideo = new CaptureRawVideo(rawvideo);
 
 #ifdef DC1394
   captureModule->addItem("DC 1394");
@@ -138,7 +147,10 @@ CaptureThread::~CaptureThread()
 {
   delete captureFiles;
   delete captureGenerator;
+  delete captureRawVideo;
   delete counter;
+  delete acquisition;
+  delete queue;
 
 #ifdef DC1394
   delete captureDC1394;
@@ -193,6 +205,8 @@ void CaptureThread::selectCaptureMethod() {
     new_capture = captureFiles;
   } else if(captureModule->getString() == "Generator") {
     new_capture = captureGenerator;
+  } else if(captureModule->getString() == "Read from raw video") {
+    new_capture = captureRawVideo;
   }
 #ifdef DC1394
   else if(captureModule->getString() == "DC 1394") {
@@ -293,6 +307,127 @@ void CaptureThread::refresh() {
 }
 
 
+void CaptureAcquisitionThread::run() {
+  owner->acquire();
+}
+
+void CaptureThread::startAcquisition() {
+  if (acquisition!=nullptr) return;
+  int depth=c_queue_depth->getInt();
+  if (queue==nullptr || queue->getDepth()!=depth) {
+    delete queue;
+    queue=new CaptureQueue(depth);
+  }
+  _kill_acquisition=false;
+  acquisition=new CaptureAcquisitionThread(this);
+  acquisition->start(QThread::HighestPriority);
+}
+
+void CaptureThread::stopAcquisition() {
+  if (acquisition==nullptr) return;
+  _kill_acquisition=true;
+  acquisition->wait();
+  delete acquisition;
+  acquisition=nullptr;
+  queue->flush();
+}
+
+void CaptureThread::acquire() {
+  while(_kill_acquisition==false) {
+    capture_mutex.lock();
+    if ((capture != nullptr) && (capture->isCapturing())) {
+      auto t_start = std::chrono::steady_clock::now();
+      RawImage pic_raw=capture->getFrame();
+      auto t_getFrame = std::chrono::steady_clock::now();
+      int idx=queue->acquireFree();
+      CaptureQueue::Slot * slot=queue->getSlot(idx);
+      bool bSuccess = convertFrame( pic_raw,slot->image);
+      slot->time=pic_raw.getTime();
+      slot->t_start=t_start;
+      slot->t_get_frame=t_getFrame;
+      slot->t_convert=std::chrono::steady_clock::now();
+      if (capture->isCapturing()) {
+        capture->releaseFrame();
+      }
+      capture_mutex.unlock();
+      if (bSuccess) {
+        queue->commit(idx);
+      } else {
+        queue->recycle(idx);
+      }
+    } else {
+      //we are not capturing...chill this thread out...
+      capture_mutex.unlock();
+      usleep(5000);
+    }
+  }
+}
+
+bool CaptureThread::convertFrame(const RawImage & src, RawImage & target) {
+  if (c_zero_copy->getBool() && capture->lendFrame(src,target)) {
+    return true;
+  }
+  return capture->copyAndConvertFrame(src,target);
+}
+
+void CaptureThread::processFrame(FrameData * d, CaptureStats * stats,
+                                 const std::chrono::steady_clock::time_point & t_start,
+                                 const std::chrono::steady_clock::time_point & t_getFrame,
+                                 const std::chrono::steady_clock::time_point & t_convert,
+                                 const std::chrono::steady_clock::time_point & t_dequeue) {
+  bool changed;
+  counter->count();
+  stats->total=d->number=counter->getTotal();
+  stats->fps_capture=counter->getFPS(changed);
+
+  stack_mutex.lock();
+  if (stack!=0) {
+    stack->process(d);
+    stack->postProcess(d);
+  }
+  stack_mutex.unlock();
+  rb->nextWrite(true);
+
+  auto t_process = std::chrono::steady_clock::now();
+
+  if(c_print_timings->getBool())
+  {
+    auto getFrame_duration = std::chrono::duration_cast<std::chrono::microseconds>(t_getFrame - t_start);
+    std::cout << std::setw(13) << std::left << "getFrame"
+              << std::setw(5) << std::right << getFrame_duration.count() << " μs" << std::endl;
+    auto convert_duration = std::chrono::duration_cast<std::chrono::microseconds>(t_convert - t_getFrame);
+    std::cout << std::setw(13) << std::left << "copy&convert"
+              << std::setw(5) << std::right << convert_duration.count() << " μs" << std::endl;
+    if (t_dequeue != t_convert) {
+      auto queue_duration = std::chrono::duration_cast<std::chrono::microseconds>(t_dequeue - t_convert);
+      std::cout << std::setw(13) << std::left << "queued"
+                << std::setw(5) << std::right << queue_duration.count() << " μs" << std::endl;
+    }
+    auto process_duration = std::chrono::duration_cast<std::chrono::microseconds>(t_process - t_dequeue);
+    std::cout << std::setw(13) << std::left << "process"
+              << std::setw(5) << std::right << process_duration.count() << " μs" << std::endl;
+    auto total_duration = std::chrono::duration_cast<std::chrono::microseconds>(t_process - t_start);
+    std::cout << std::setw(13) << std::left << "total"
+              << std::setw(5) << std::right << total_duration.count() << " μs" << std::endl;
+    if (acquisition != nullptr) {
+      std::cout << std::setw(13) << std::left << "dropped"
+                << std::setw(5) << std::right << stats->dropped << std::endl;
+    }
+    std::cout << std::endl;
+  }
+
+  if (changed) {
+    if (c_auto_refresh->getBool()==true) {
+      capture_mutex.lock();
+      if ((capture != 0) && (capture->isCapturing())) capture->readAllParameterValues();
+      capture_mutex.unlock();
+    }
+    stack_mutex.lock();
+    stack->updateTimingStatistics();
+    stack_mutex.unlock();
+  }
+}
+
 void CaptureThread::run() {
     CaptureStats * stats;
     bool changed;
@@ -308,72 +443,60 @@ void CaptureThread::run() {
         if ((stats=(CaptureStats *)d->map.get("capture_stats")) == 0) {
           stats=(CaptureStats *)d->map.insert("capture_stats",new CaptureStats());
         }
-        capture_mutex.lock();
-        if ((capture != nullptr) && (capture->isCapturing())) {
-          auto t_start = std::chrono::steady_clock::now();
-          RawImage pic_raw=capture->getFrame();
-          auto t_getFrame = std::chrono::steady_clock::now();
-          d->time=pic_raw.getTime();
-          bool bSuccess = capture->copyAndConvertFrame( pic_raw,d->video);
-          auto t_convert = std::chrono::steady_clock::now();
-          capture_mutex.unlock();
-
-          if (bSuccess) {           //only on a good frame read do we proceed
-              counter->count();
-              stats->total=d->number=counter->getTotal();
-              stats->fps_capture=counter->getFPS(changed);
-
-              stack_mutex.lock();
-              if (stack!=0) {
-                stack->process(d);
-                stack->postProcess(d);
-              }
-              stack_mutex.unlock();
-              rb->nextWrite(true);
-
-            auto t_process = std::chrono::steady_clock::now();
-
-              if(c_print_timings->getBool())
-              {
-                auto getFrame_duration = std::chrono::duration_cast<std::chrono::microseconds>(t_getFrame - t_start);
-                std::cout << std::setw(13) << std::left << "getFrame"
-                          << std::setw(5) << std::right << getFrame_duration.count() << " μs" << std::endl;
-                auto convert_duration = std::chrono::duration_cast<std::chrono::microseconds>(t_convert - t_getFrame);
-                std::cout << std::setw(13) << std::left << "copy&convert"
-                          << std::setw(5) << std::right << convert_duration.count() << " μs" << std::endl;
-                auto process_duration = std::chrono::duration_cast<std::chrono::microseconds>(t_process - t_convert);
-                std::cout << std::setw(13) << std::left << "process"
-                          << std::setw(5) << std::right << process_duration.count() << " μs" << std::endl;
-                auto total_duration = std::chrono::duration_cast<std::chrono::microseconds>(t_process - t_start);
-                std::cout << std::setw(13) << std::left << "total"
-                          << std::setw(5) << std::right << total_duration.count() << " μs" << std::endl << std::endl;
-              }
-
-              if (changed) {
-                if (c_auto_refresh->getBool()==true) {
-                  capture_mutex.lock();
-                  if ((capture != 0) && (capture->isCapturing())) capture->readAllParameterValues();
-                  capture_mutex.unlock();
-                }
-                stack_mutex.lock();
-                stack->updateTimingStatistics();
-                stack_mutex.unlock();
-              }
+        if (c_pipelined->getBool()) {
+          if (acquisition != nullptr && queue->getDepth() != c_queue_depth->getInt()) {
+            stopAcquisition();
           }
-
+          startAcquisition();
+          int slot_idx=queue->waitFilled(5);
+          stats->dropped=queue->getDropped();
+          if (slot_idx != -1) {
+            auto t_dequeue = std::chrono::steady_clock::now();
+            CaptureQueue::Slot * slot=queue->getSlot(slot_idx);
+            //hand the converted image over to the frame buffer and give
+            //the slot our previous buffer to fill next.
+            std::swap(d->video,slot->image);
+            d->time=slot->time;
+            auto t_start=slot->t_start;
+            auto t_getFrame=slot->t_get_frame;
+            auto t_convert=slot->t_convert;
+            queue->recycle(slot_idx);
+            processFrame(d,stats,t_start,t_getFrame,t_convert,t_dequeue);
+          } else {
+            stats->total=d->number=counter->getTotal();
+            stats->fps_capture=counter->getFPS(changed);
+          }
+        } else {
+          stopAcquisition();
           capture_mutex.lock();
           if ((capture != nullptr) && (capture->isCapturing())) {
-            capture->releaseFrame();
+            auto t_start = std::chrono::steady_clock::now();
+            RawImage pic_raw=capture->getFrame();
+            auto t_getFrame = std::chrono::steady_clock::now();
+            d->time=pic_raw.getTime();
+            bool bSuccess = convertFrame( pic_raw,d->video);
+            auto t_convert = std::chrono::steady_clock::now();
+            capture_mutex.unlock();
+
+            if (bSuccess) {           //only on a good frame read do we proceed
+              processFrame(d,stats,t_start,t_getFrame,t_convert,t_convert);
+            }
+
+            capture_mutex.lock();
+            if ((capture != nullptr) && (capture->isCapturing())) {
+              capture->releaseFrame();
+            }
+            capture_mutex.unlock();
+          } else {
+            stats->total=d->number=counter->getTotal();
+            stats->fps_capture=counter->getFPS(changed);
+            //we are not capturing...chill this thread out...
+            capture_mutex.unlock();
+            usleep(5000);
           }
-          capture_mutex.unlock();
-        } else {
-          stats->total=d->number=counter->getTotal();
-          stats->fps_capture=counter->getFPS(changed);
-          //we are not capturing...chill this thread out...
-          capture_mutex.unlock();
-          usleep(5000);
         }
         if (_kill) {
+          stopAcquisition();
           capture_mutex.lock();
           if(capture != nullptr) {
             capture->stopCapture();
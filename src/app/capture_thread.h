@@ -25,9 +25,11 @@
 #include "capturefromfile.h"
 #include "capturev4l.h"
 #include "capture_generator.h"
+#include "capture_rawvideo.h"
 #include "capture_splitter.h"
 #include <QThread>
 #include "ringbuffer.h"
+#include "capture_queue.h"
 #include "framedata.h"
 #include "framecounter.h"
 #include "visionstack.h"
@@ -54,6 +56,25 @@
 #include "capture_spinnaker.h"
 #endif
 
+class CaptureThread;
+
+/*!
+  \class   CaptureAcquisitionThread
+  \brief   The frame acquisition side of a pipelined CaptureThread
+
+  When pipelined capture is enabled, this thread grabs and converts
+  frames into a CaptureQueue while the owning CaptureThread runs the
+  vision stack on the previous frame.
+*/
+class CaptureAcquisitionThread : public QThread
+{
+protected:
+  CaptureThread * owner;
+public:
+  CaptureAcquisitionThread(CaptureThread * _owner) : owner(_owner) {}
+  virtual void run();
+};
+
 /*!
   \class   CaptureThread
   \brief   A thread for capturing and processing video data
@@ -62,6 +83,7 @@
 class CaptureThread : public QThread
 {
 Q_OBJECT
+friend class CaptureAcquisitionThread;
 protected:
   QMutex stack_mutex; //this mutex protects multi-threaded operations on the stack
   QMutex capture_mutex; //this mutex protects multi-threaded operations on the capture control
@@ -75,12 +97,16 @@ protected:
   CaptureInterface * captureFlycap = nullptr;
   CaptureInterface * captureFiles = nullptr;
   CaptureInterface * captureGenerator = nullptr;
+  CaptureInterface * captureRawVideo = nullptr;
   CaptureInterface * captureBasler = nullptr;
   CaptureInterface * captureSpinnaker = nullptr;
   CaptureInterface * captureSplitter = nullptr;
   AffinityManager * affinity;
   FrameBuffer * rb;
+  CaptureQueue * queue = nullptr;
+  CaptureAcquisitionThread * acquisition = nullptr;
   bool _kill;
+  bool _kill_acquisition = false;
   int camId;
   VarList * settings;
   VarList * dc1394 = nullptr;
@@ -90,6 +116,7 @@ protected:
   VarList * flycap = nullptr;
   VarList * generator = nullptr;
   VarList * fromfile = nullptr;
+  VarList * rawvideo = nullptr;
   VarList * basler = nullptr;
   VarList * spinnaker = nullptr;
   VarList * splitter = nullptr;
@@ -100,8 +127,21 @@ protected:
   VarTrigger * c_refresh;
   VarBool * c_auto_refresh;
   VarBool * c_print_timings;
+  VarBool * c_pipelined;
+  VarBool * c_zero_copy;
+  VarInt * c_queue_depth;
   VarStringEnum * captureModule;
 
+  void startAcquisition();
+  void stopAcquisition();
+  void acquire();
+  bool convertFrame(const RawImage & src, RawImage & target);
+  void processFrame(FrameData * d, CaptureStats * stats,
+                    const std::chrono::steady_clock::time_point & t_start,
+                    const std::chrono::steady_clock::time_point & t_getFrame,
+                    const std::chrono::steady_clock::time_point & t_convert,
+                    const std::chrono::steady_clock::time_point & t_dequeue);
+
 public slots:
   bool init();
   bool stop();
@@ -118,6 +158,7 @@ public:
   VarList * getSettings();
   void setAffinityManager(AffinityManager * _affinity);
   CaptureInterface* getCaptureSplitter() {return captureSplitter;};
+  CaptureInterface* getCaptureGenerator() {return captureGenerator;};
   CaptureThread(int cam_id);
   ~CaptureThread();
 
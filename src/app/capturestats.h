@@ -31,9 +31,11 @@ class CaptureStats {
   public:
   double fps_capture;
   long long total;
+  long long dropped;
   CaptureStats() {
     fps_capture=0.0;
     total=0;
+    dropped=0;
   }
 };
 
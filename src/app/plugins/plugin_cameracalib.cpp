@@ -72,6 +72,13 @@ void PluginCameraCalibration::detectEdges(FrameData* data) {
     Images::convert(*rgb_image, *grey_image);
   } else if (data->video.getColorFormat()==COLOR_RGB8) {
     Images::convert(data->video, *grey_image);
+  } else if (data->video.getColorFormat()==COLOR_RAW8) {
+    for (int y=0;y<data->video.getHeight();y++) {
+      for (int x=0;x<data->video.getWidth();x++) {
+        rgb_image->setPixel(x,y,data->video.getRgb(x,y));
+      }
+    }
+    Images::convert(*rgb_image, *grey_image);
   } else {
     fprintf(stderr, "ColorThresholding needs YUV422 or RGB8 as input image, "
             "but found: %s\n",
@@ -104,10 +104,12 @@ void PluginColorCalibration::mouseEvent( QMouseEvent * event, pixelloc loc) {
               } else {
                 color.y=color2.y2;
               }
+            } else if (source_format==COLOR_RAW8) {
+              color=frame->video.getYuv(loc.x,loc.y);
             } else {
               //blank it:
               fprintf(stderr,"Unable to pick color from frame of format: %s\n",Colors::colorFormatToString(source_format).c_str());
-              fprintf(stderr,"Currently supported are rgb8, yuv444, and yuv422 (UYVY).\n");
+              fprintf(stderr,"Currently supported are rgb8, yuv444, yuv422 (UYVY), and raw8 (bayer).\n");
               fprintf(stderr,"(Feel free to add more conversions to plugin_colorcalib.cpp).\n");
             }
             lutw->samplePixel(color);
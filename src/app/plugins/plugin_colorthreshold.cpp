@@ -20,148 +20,127 @@
 //========================================================================
 #include "plugin_colorthreshold.h"
 
-static void thresholdImage(RawImage *imagePartIn, Image<raw8> *imagePartOut, YUVLUT * lut, const ImageInterface* mask = nullptr) {
-  if (imagePartIn->getColorFormat() == COLOR_YUV422_UYVY) {
-    CMVisionThreshold::thresholdImageYUV422_UYVY(imagePartOut, imagePartIn, lut, mask);
-  } else if (imagePartIn->getColorFormat() == COLOR_YUV444) {
-    CMVisionThreshold::thresholdImageYUV444(imagePartOut, imagePartIn, lut, mask);
-  } else if (imagePartIn->getColorFormat() == COLOR_RGB8) {
-    auto *rgblut = (RGBLUT *) lut->getDerivedLUT(CSPACE_RGB);
-    if (rgblut == nullptr) {
-      printf("WARNING: No RGB LUT has been defined. You need to create a derived RGB LUT by calling e.g. \"lut_yuv->addDerivedLUT(new RGBLUT(5,5,5,\"\"))\" in the stack constructor!\n");
-    } else {
-      CMVisionThreshold::thresholdImageRGB(imagePartOut, imagePartIn, rgblut, mask);
-    }
-  } else {
-    fprintf(stderr, "ColorThresholding needs YUV422, YUV444, or RGB8 as input image, but found: %s\n",
-            Colors::colorFormatToString(imagePartIn->getColorFormat()).c_str());
-  }
-}
-
-PluginColorThresholdWorker::PluginColorThresholdWorker(int _id, int _totalThreads, YUVLUT * _lut) : QObject() {
-
-  this->id = _id;
-  this->totalThreads = _totalThreads;
-  this->lut = _lut;
-
-  thread = new QThread();
-  thread->setObjectName("ColorThreshold");
-  moveToThread(thread);
-  connect(this, SIGNAL(startThresholding()), this, SLOT(process()));
-  thread->start();
-}
-
-PluginColorThresholdWorker::~PluginColorThresholdWorker() {
-  thread->quit();
-  thread->deleteLater();
-}
-
-
-void PluginColorThresholdWorker::process() {
-  RawImage imagePartIn;
-  imagePartIn.setColorFormat(imageIn->getColorFormat());
-  imagePartIn.setHeight(imageIn->getHeight()/totalThreads);
-  imagePartIn.setWidth(imageIn->getWidth());
-  int offsetBytesIn = id * imageIn->getNumBytes() / totalThreads;
-  imagePartIn.setData(imageIn->getData() + offsetBytesIn);
-
-  RawImage maskImagePartIn;
-  maskImagePartIn.setColorFormat(maskImageIn->getColorFormat());
-  maskImagePartIn.setHeight(maskImageIn->getHeight()/totalThreads);
-  maskImagePartIn.setWidth(maskImageIn->getWidth());
-  int maskOffsetBytesIn = id * maskImageIn->getNumBytes() /  totalThreads;
-  maskImagePartIn.setData(maskImageIn->getData() + maskOffsetBytesIn);
-
-  RawImage rawImageOut;
-  rawImageOut.setColorFormat(imageOut->getColorFormat());
-  rawImageOut.setHeight(imageOut->getHeight()/totalThreads);
-  rawImageOut.setWidth(imageOut->getWidth());
-  int offsetBytesOut = id * imageOut->getNumBytes() / totalThreads;
-  rawImageOut.setData(imageOut->getData() + offsetBytesOut);
-  Image<raw8> imagePartOut;
-  imagePartOut.fromRawImage(rawImageOut);
-  
-  thresholdImage(&imagePartIn, &imagePartOut, lut, &maskImagePartIn);
-
-  doneMutex.unlock();
-}
-
-
-void PluginColorThresholdWorker::start() {
-  doneMutex.lock();
-  emit startThresholding();
-}
-
-
-void PluginColorThresholdWorker::wait() {
-  doneMutex.lock();
-  doneMutex.unlock();
-}
-
-
-PluginColorThreshold::PluginColorThreshold(FrameBuffer * _buffer, YUVLUT * _lut, ConvexHullImageMask &mask)
+PluginColorThreshold::PluginColorThreshold(FrameBuffer * _buffer, YUVLUT * _lut, ConvexHullImageMask &mask, WorkerPool * _pool)
   : VisionPlugin(_buffer), _image_mask(mask)
 {
   lut=_lut;
+  pool=_pool;
 
   settings=new VarList("Color Threshold");
-  numThreads = new VarInt("number of threads", 0, 0, 32);
-  settings->addChild(numThreads);
+  //when no plugin reads the thresholded image, the run-length encoder
+  //thresholds the frame itself and the image is never written:
+  fuseRunlengthEncoding = new VarBool("fused run-length encoding", true);
+  settings->addChild(fuseRunlengthEncoding);
+  //summed-area tables of the color channels the detectors read, which answer
+  //their box histograms in constant time, at the cost of a pass over the frame:
+  integralHistogram = new VarBool("integral histogram", false);
+  settings->addChild(integralHistogram);
+  thresholdedImageWritten = true;
 }
 
 
 PluginColorThreshold::~PluginColorThreshold()
 {
-  clearWorkers();
   delete settings;
-}
-
-void PluginColorThreshold::clearWorkers() {
-  for (auto worker : workers) {
-    worker->deleteLater();
-  }
-  workers.clear();
+  delete fuseRunlengthEncoding;
+  delete integralHistogram;
 }
 
 
 ProcessResult PluginColorThreshold::process(FrameData * data, RenderOptions * options) {
-  _image_mask.lock();
   (void)options;
 
   Image<raw8> * img_thresholded;
+  CMVision::IntegralHistogram * integral_histogram;
 
+  //the image is always inserted, as plugins look it up even if they end up not reading it
   if ((img_thresholded=(Image<raw8> *)data->map.get("cmv_threshold")) == nullptr) {
     img_thresholded=(Image<raw8> *)data->map.insert("cmv_threshold",new Image<raw8>());
   }
+  if ((integral_histogram=(CMVision::IntegralHistogram *)data->map.get("cmv_integral_histogram")) == nullptr) {
+    integral_histogram=(CMVision::IntegralHistogram *)data->map.insert("cmv_integral_histogram",new CMVision::IntegralHistogram());
+  }
+  integral_histogram->clear();
+
+  thresholdedImageWritten = (fuseRunlengthEncoding->getBool() == false);
+  for (auto plugin : thresholdedImageConsumers) {
+    if (thresholdedImageWritten) break;
+    thresholdedImageWritten = plugin->usesThresholdedImage();
+  }
+  if (!thresholdedImageWritten) {
+    //an empty image tells the consumers that it does not hold this frame:
+    img_thresholded->clear();
+    return ProcessingOk;
+  }
 
   //make sure image is allocated:
   img_thresholded->allocate(data->video.getWidth(),data->video.getHeight());
 
-  if(workers.size() != numThreads->getInt()) {
-    clearWorkers();
-    for(int i=0;i<numThreads->getInt();i++) {
-      auto *worker = new PluginColorThresholdWorker(i, numThreads->getInt(), lut);
-      workers.push_back(worker);
+  //one band of whole rows per thread:
+  int width = data->video.getWidth();
+  int height = data->video.getHeight();
+  int bands = pool->getConcurrency();
+  auto * target = (uint8_t *) img_thresholded->getPixelData();
+  _image_mask.lock();
+  const ImageMaskSpans * spans = &_image_mask.getSpans();
+  pool->run("ColorThreshold", bands, [&](int band) {
+    int row_begin, row_end;
+    WorkerPool::splitRange(height, bands, band, row_begin, row_end);
+    CMVisionThreshold::thresholdRows(target + row_begin * width, &data->video, lut, spans, row_begin, row_end);
+  });
+  _image_mask.unlock();
+
+  //tables only for the channels that some plugin reads box histograms of:
+  integralHistogramChannels.clear();
+  if (integralHistogram->getBool()) {
+    int num_channels = lut->getChannelCount();
+    for (int c = 0; c < num_channels; c++) {
+      for (auto plugin : thresholdedImageConsumers) {
+        if (plugin->usesBoxHistograms(c)) {
+          integralHistogramChannels.push_back(c);
+          break;
+        }
+      }
     }
   }
+  if (integralHistogramChannels.empty() == false) {
+    integral_histogram->build(img_thresholded, integralHistogramChannels, pool);
+  }
 
-  if(workers.empty()) {
-    thresholdImage(&data->video, img_thresholded, lut, &_image_mask.getMask());
-  } else {
-    for (auto worker : workers) {
-      worker->imageIn = &data->video;
-      worker->maskImageIn = &_image_mask.getMask();
-      worker->imageOut = img_thresholded;
-      worker->start();
-    }
+  return ProcessingOk;
+}
 
-    for (auto worker : workers) {
-      worker->wait();
-    }
-  }
+void PluginColorThreshold::setThresholdedImageConsumers(const std::vector<VisionPlugin*> & plugins) {
+  thresholdedImageConsumers = plugins;
+}
 
+bool PluginColorThreshold::hasWrittenThresholdedImage() const {
+  return thresholdedImageWritten;
+}
+
+bool PluginColorThreshold::thresholdAndEncodeRuns(FrameData * data, CMVision::RunList * runlist) {
+  int height = data->video.getHeight();
+  int bands = pool->getConcurrency();
+  encodeBands.setup(bands, runlist->getMaxRuns() / bands);
+  std::atomic<bool> ok(true);
+  _image_mask.lock();
+  const ImageMaskSpans * spans = &_image_mask.getSpans();
+  if (bands == 1) {
+    ok = CMVision::RegionProcessing::thresholdAndEncodeRuns(&data->video, lut, spans, runlist, encodeBands.getStrip(0));
+    _image_mask.unlock();
+    return ok;
+  }
+  pool->run("ThresholdAndEncodeRuns", bands, [&](int band) {
+    int row_begin, row_end;
+    WorkerPool::splitRange(height, bands, band, row_begin, row_end);
+    if (CMVision::RegionProcessing::thresholdAndEncodeRuns(&data->video, lut, spans, encodeBands.getSegment(band),
+                                                           encodeBands.getStrip(band), row_begin, row_end) == false) {
+      ok = false;
+    }
+  });
   _image_mask.unlock();
-  return ProcessingOk;
+  encodeBands.join(runlist);
+  return ok;
 }
 
 VarList * PluginColorThreshold::getSettings() {
@@ -24,35 +24,10 @@
 #include <visionplugin.h>
 #include "lut3d.h"
 #include "cmvision_threshold.h"
-#include <mutex>
-#include <QThread>
-#include <QObject>
+#include "cmvision_region.h"
+#include "cmvision_histogram.h"
 #include "convex_hull_image_mask.h"
-
-class PluginColorThresholdWorker : public QObject {
-Q_OBJECT
-public:
-    PluginColorThresholdWorker(int id, int totalThreads, YUVLUT * lut);
-    ~PluginColorThresholdWorker() override;
-    QThread* thread;
-    int id;
-    int totalThreads;
-    RawImage* imageIn = nullptr;
-    const ImageInterface* maskImageIn = nullptr;
-    Image<raw8>* imageOut = nullptr;
-    YUVLUT * lut;
-    std::mutex doneMutex;
-
-    void start();
-    void wait();
-
-public slots:
-    void process();
-
-signals:
-    void startThresholding();
-
-};
+#include "worker_pool.h"
 
 /**
 	@author Stefan Zickler
@@ -62,10 +37,16 @@ class PluginColorThreshold : public VisionPlugin
 protected:
   YUVLUT * lut;
   ConvexHullImageMask& _image_mask;
+  WorkerPool * pool;
   VarList * settings;
-  VarInt * numThreads;
+  VarBool * fuseRunlengthEncoding;
+  VarBool * integralHistogram;
+  std::vector<VisionPlugin*> thresholdedImageConsumers;
+  std::vector<int> integralHistogramChannels;
+  bool thresholdedImageWritten;
+  CMVision::BandedRunList encodeBands;
 public:
-  PluginColorThreshold(FrameBuffer * _buffer, YUVLUT * _lut, ConvexHullImageMask& mask);
+  PluginColorThreshold(FrameBuffer * _buffer, YUVLUT * _lut, ConvexHullImageMask& mask, WorkerPool * _pool);
 
     ~PluginColorThreshold() override;
 
@@ -74,10 +55,18 @@ public:
     VarList * getSettings() override;
 
     string getName() override;
-private:
-    std::vector<PluginColorThresholdWorker*> workers;
 
-    void clearWorkers();
+    /// the plugins whose usesThresholdedImage() decides whether "cmv_threshold" has to be written,
+    /// and whose usesBoxHistograms() decides which channels "cmv_integral_histogram" is built for
+    void setThresholdedImageConsumers(const std::vector<VisionPlugin*> & plugins);
+
+    /// false if the current frame was left to thresholdAndEncodeRuns(), in which case
+    /// "cmv_threshold" is an empty image for the current frame
+    bool hasWrittenThresholdedImage() const;
+
+    /// thresholds the current frame straight into \p runlist, for the run-length encoder.
+    /// The bands of the image are encoded in parallel.
+    bool thresholdAndEncodeRuns(FrameData * data, CMVision::RunList * runlist);
 };
 
 #endif
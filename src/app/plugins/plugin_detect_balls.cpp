@@ -18,11 +18,11 @@
   \author  Author Name, 2009
 */
 //========================================================================
-#include <list>
+#include <algorithm>
 #include "plugin_detect_balls.h"
 
-PluginDetectBalls::PluginDetectBalls ( FrameBuffer * _buffer, LUT3D * lut, const CameraParameters& camera_params, const RoboCupField& field,PluginDetectBallsSettings * settings )
-    : VisionPlugin ( _buffer ), camera_parameters ( camera_params ), field ( field ) {
+PluginDetectBalls::PluginDetectBalls ( FrameBuffer * _buffer, LUT3D * lut, const CameraParameters& camera_params, const RoboCupField& field,PluginDetectBallsSettings * settings, WorkerPool * _pool )
+    : VisionPlugin ( _buffer ), camera_parameters ( camera_params ), field ( field ), pool ( _pool ), ball_height_table ( camera_params ) {
   _lut=lut;
 
   _settings=settings;
@@ -70,13 +70,33 @@ string PluginDetectBalls::getName() {
   return "DetectBalls";
 }
 
-bool PluginDetectBalls::checkHistogram ( const Image<raw8> * image, const CMVision::Region * reg, double min_greenness, double max_markeryness ) {
+bool PluginDetectBalls::usesThresholdedImage() {
+  return _settings->_ball_histogram_enabled->getBool() && _settings->_max_balls->getInt() > 0;
+}
+
+bool PluginDetectBalls::usesBoxHistograms(int color_id) {
+  //the channels that checkHistogram() reads:
+  return usesThresholdedImage() && color_id != -1 &&
+         ( color_id == color_id_orange || color_id == color_id_pink || color_id == color_id_yellow || color_id == color_id_field );
+}
+
+bool PluginDetectBalls::usesColorRegions(int color_id) {
+  return color_id == _lut->getChannelID ( _settings->_color_label->getString() );
+}
+
+bool PluginDetectBalls::checkHistogram ( const Image<raw8> * image, const CMVision::IntegralHistogram * integral_histogram, const CMVision::Region * reg, double min_greenness, double max_markeryness ) {
   static const int PixelRadius = 4;
 
   histogram->clear();
 
-  int num = histogram->addBox ( image, reg->x1 - PixelRadius, reg->y1 - PixelRadius,
-                                reg->x2 + PixelRadius, reg->y2 + PixelRadius );
+  int num;
+  if ( integral_histogram != 0 ) {
+    num = histogram->addBox ( integral_histogram, reg->x1 - PixelRadius, reg->y1 - PixelRadius,
+                              reg->x2 + PixelRadius, reg->y2 + PixelRadius );
+  } else {
+    num = histogram->addBox ( image, reg->x1 - PixelRadius, reg->y1 - PixelRadius,
+                              reg->x2 + PixelRadius, reg->y2 + PixelRadius );
+  }
 
 
   float pf = ( float ) ( histogram->getChannel ( color_id_pink ) ) / ( float ) ( histogram->getChannel ( color_id_orange ) );
@@ -89,22 +109,67 @@ bool PluginDetectBalls::checkHistogram ( const Image<raw8> * image, const CMVisi
   return ( true );
 }
 
-//Data structure for storing and sorting the filtered regions
-class BallDetectResult
-{
-public:
-  const CMVision::Region* reg;
-  float conf;
+void PluginDetectBalls::initNearRobots ( const SSL_DetectionFrame * detection_frame ) {
+  robots_near.clear();
+  robots_near_groups.clear();
+  for ( int team = 0; team < 2; team++ ) {
+    const ::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot > & robots =
+      ( team==0 ) ? detection_frame->robots_blue() : detection_frame->robots_yellow();
+    for ( int r = 0; r < robots.size(); r++ ) {
+      const SSL_DetectionRobot & robot = robots.Get ( r );
+      if ( robot.confidence() > 0.0 ) {
+        NearRobot near;
+        near.height = robot.height();
+        near.x = robot.x();
+        near.y = robot.y();
+        robots_near.push_back ( near );
+      }
+    }
+  }
 
-  BallDetectResult(const CMVision::Region* reg, float conf) {
-    this->reg = reg;
-    this->conf = conf;    
+  //robots of one height share the projection of the ball, and within a height
+  //only the robots in the x-range of the ball need to be looked at:
+  std::sort ( robots_near.begin(),robots_near.end(),[] ( const NearRobot & a, const NearRobot & b ) {
+    return a.height < b.height || ( a.height == b.height && a.x < b.x );
+  } );
+  int n = ( int ) robots_near.size();
+  for ( int i = 0; i < n; i++ ) {
+    if ( i == 0 || robots_near[i].height != robots_near[i-1].height ) {
+      NearRobotGroup group;
+      group.height = robots_near[i].height;
+      group.begin = i;
+      group.end = i;
+      robots_near_groups.push_back ( group );
+    }
+    robots_near_groups.back().end = i + 1;
   }
+}
 
-  bool operator< (BallDetectResult a) {
-    return conf < a.conf;
+bool PluginDetectBalls::isNearRobot ( const CameraParameters::Snapshot & calibration, const vector2d & pixel_pos, const vector2d & field_pos ) const {
+  for ( size_t g = 0; g < robots_near_groups.size(); g++ ) {
+    const NearRobotGroup & group = robots_near_groups[g];
+    vector2d pos = field_pos;
+    if ( group.height != z_height ) {
+      vector3d pos_3d;
+      calibration.image2field ( pos_3d, pixel_pos, group.height );
+      pos.set ( pos_3d.x,pos_3d.y );
+    }
+    NearRobot lower;
+    lower.height = group.height;
+    lower.x = pos.x - near_robot_dist;
+    lower.y = 0.0;
+    std::vector<NearRobot>::const_iterator it = std::lower_bound ( robots_near.begin() + group.begin,robots_near.begin() + group.end,lower,
+                                                                   [] ( const NearRobot & a, const NearRobot & b ) {
+      return a.x < b.x;
+    } );
+    for ( ; it != robots_near.begin() + group.end && it->x <= pos.x + near_robot_dist; ++it ) {
+      if ( ( sq ( it->x - pos.x ) + sq ( it->y - pos.y ) ) < near_robot_dist_sq ) {
+        return true;
+      }
+    }
   }
-};
+  return false;
+}
 
 ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * options ) {
   ( void ) options;
@@ -162,8 +227,11 @@ ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * opt
     z_height= _settings->_ball_z_height->getDouble();
 
     near_robot_filter = _settings->_ball_too_near_robot_enabled->getBool();
-    near_robot_dist_sq = sq(_settings->_ball_too_near_robot_dist->getDouble());
+    near_robot_dist = fabs(_settings->_ball_too_near_robot_dist->getDouble());
+    near_robot_dist_sq = sq(near_robot_dist);
   }
+  std::shared_ptr<const CameraParameters::Snapshot> calibration = camera_parameters.getSnapshot();
+  ball_height_table.update ( data->video.getWidth(),data->video.getHeight(),z_height,pool );
 
   const CMVision::Region * reg = 0;
 
@@ -183,22 +251,22 @@ ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * opt
     return ProcessingFailed;
   }
 
-  int robots_blue_n=0;
-  int robots_yellow_n=0;
+  //the histogram check uses the integral histogram, if thresholding built one:
+  const CMVision::IntegralHistogram * integral_histogram = ( CMVision::IntegralHistogram * ) ( data->map.get ( "cmv_integral_histogram" ) );
+  if ( integral_histogram != 0 && integral_histogram->isEmpty() ) integral_histogram = 0;
+
+  //the image is empty if thresholding decided that no plugin reads it this frame,
+  //as it does when the histogram filter was enabled only after that decision:
+  bool use_histogram_filter = filter_ball_histogram && image->getNumPixels() > 0;
+
   bool use_near_robot_filter=near_robot_filter;
   if ( use_near_robot_filter ) {
-    SSL_DetectionFrame * detection_frame = ( SSL_DetectionFrame * ) data->map.get ( "ssl_detection_frame" );
-    if ( detection_frame==0 ) {
-      use_near_robot_filter=false;
-    } else {
-      robots_blue_n=detection_frame->robots_blue_size();
-      robots_yellow_n=detection_frame->robots_yellow_size();
-      if (robots_blue_n==0 && robots_yellow_n==0) use_near_robot_filter=false;
-    }
+    initNearRobots ( detection_frame );
+    if ( robots_near.empty() ) use_near_robot_filter=false;
   }
 
   if ( max_balls > 0 ) {
-    list<BallDetectResult> result;
+    candidates.clear();
     filter.init ( reg );
     
     while ( ( reg = filter.getNext() ) != 0 ) {
@@ -216,7 +284,7 @@ ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * opt
       //convert from image to field coordinates:
       vector2d pixel_pos ( reg->cen_x,reg->cen_y );
       vector3d field_pos_3d;
-      camera_parameters.image2field ( field_pos_3d,pixel_pos,z_height );
+      ball_height_table.image2field ( field_pos_3d,pixel_pos );
       vector2d field_pos ( field_pos_3d.x,field_pos_3d.y );
 
       //filter points that are outside of the field:
@@ -229,73 +297,48 @@ ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * opt
         conf = 0.0;
       }
 
-      //TODO add ball-too-near-robot filter
-      if ( use_near_robot_filter && conf > 0.0 ) {
-        int robots_n=0;
-        for (int team = 0; team < 2; team++) {
-          if (team==0) {
-            robots_n=robots_blue_n;
-          } else {
-            robots_n=robots_yellow_n;
-          }
-          if (robots_n > 0) {
-            ::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot > * robots;
-            if (team==0) {
-              robots = detection_frame->mutable_robots_blue();
-            } else {
-              robots = detection_frame->mutable_robots_yellow();
-            }
-            for (int r = 0; r < robots_n; r++) {
-              const SSL_DetectionRobot & robot = robots->Get(r);
-              if (robot.confidence() > 0.0) {
-                vector3d field_on_bot_pos_3d;
-                camera_parameters.image2field ( field_on_bot_pos_3d, pixel_pos, robot.height());
-                if ((sq((double)(robot.x())-(double)(field_on_bot_pos_3d.x)) + sq((double)(robot.y())-(double)(field_on_bot_pos_3d.y))) < near_robot_dist_sq) {
-                  conf = 0.0;
-                  break;
-                }
-              }
-            }
-            if (conf==0.0) break;
-          }
-        }
+      //filter out points that are too near to a robot
+      if ( use_near_robot_filter && conf > 0.0 && isNearRobot ( *calibration, pixel_pos, field_pos ) ) {
+        conf = 0.0;
       }
 
       // histogram check if enabled
-      if ( filter_ball_histogram && conf > 0.0 && checkHistogram ( image, reg, min_greenness, max_markeryness ) ==false ) {
+      if ( use_histogram_filter && conf > 0.0 && checkHistogram ( image, integral_histogram, reg, min_greenness, max_markeryness ) ==false ) {
         conf = 0.0;
       }
 
-      // add filtered region to the region list
+      // add filtered region to the candidate list
       if(conf > 0) {
-        result.push_back(BallDetectResult(reg,conf));
+        BallCandidate candidate;
+        candidate.reg = reg;
+        candidate.conf = conf;
+        candidate.index = ( int ) candidates.size();
+        candidate.field_pos = field_pos;
+        candidates.push_back ( candidate );
       }
 
     }
 
-    // sort result by confidence and output first max_balls region(s)
-    result.sort();
-    
-    int num_ball = 0;
-    list<BallDetectResult>::reverse_iterator it;
-    for(it=result.rbegin(); it!=result.rend(); it++) {
-      if(++num_ball > max_balls)
-        break;
+    // output the max_balls candidates of highest confidence, the later detected
+    // one first among equal confidences
+    int num_balls = min ( ( int ) candidates.size(),max_balls );
+    std::partial_sort ( candidates.begin(),candidates.begin() + num_balls,candidates.end(),
+                        [] ( const BallCandidate & a, const BallCandidate & b ) {
+      return a.conf > b.conf || ( a.conf == b.conf && a.index > b.index );
+    } );
+
+    for ( int i = 0; i < num_balls; i++ ) {
+      const BallCandidate & candidate = candidates[i];
 
       //update result:
       SSL_DetectionBall* ball = detection_frame->add_balls();
 
-      ball->set_confidence ( it->conf );
-
-      vector2d pixel_pos ( it->reg->cen_x,it->reg->cen_y );
-      vector3d field_pos_3d;
-      camera_parameters.image2field ( field_pos_3d,pixel_pos,z_height );
-
-      ball->set_area ( it->reg->area );
-      ball->set_x ( field_pos_3d.x );
-      ball->set_y ( field_pos_3d.y );
-      ball->set_pixel_x ( it->reg->cen_x );
-      ball->set_pixel_y ( it->reg->cen_y );
+      ball->set_confidence ( candidate.conf );
+      ball->set_area ( candidate.reg->area );
+      ball->set_x ( candidate.field_pos.x );
+      ball->set_y ( candidate.field_pos.y );
+      ball->set_pixel_x ( candidate.reg->cen_x );
+      ball->set_pixel_y ( candidate.reg->cen_y );
     }
 
   }
@@ -25,11 +25,13 @@
 #include "cmvision_region.h"
 #include "messages_robocup_ssl_detection.pb.h"
 #include "camera_calibration.h"
+#include "image2field_table.h"
 #include "field_filter.h"
 #include "cmvision_histogram.h"
 #include "vis_util.h"
 #include "VarNotifier.h"
 #include "lut3d.h"
+#include "worker_pool.h"
 /**
 	@author Author Name
 */
@@ -133,6 +135,7 @@ protected:
   double exp_area_var;
   double z_height;
   bool near_robot_filter;
+  double near_robot_dist;
   double near_robot_dist_sq;
   int max_balls;
   //-----------------------------
@@ -155,19 +158,60 @@ protected:
 
   const CameraParameters& camera_parameters;
   const RoboCupField& field;
+  WorkerPool * pool;
 
   FieldFilter field_filter;
 
-  bool checkHistogram(const Image<raw8> * image, const CMVision::Region * reg, double min_greenness=0.5, double max_markeryness=2.0);
+  // field positions of all pixels at the ball height
+  Image2FieldTable ball_height_table;
+
+  //a ball that passed all filters, before it is written to the detection frame
+  struct BallCandidate {
+    const CMVision::Region * reg;
+    float conf;
+    //order of detection, which breaks ties in confidence
+    int index;
+    vector2d field_pos;
+  };
+
+  //a robot position for the near robot filter
+  struct NearRobot {
+    double height;
+    double x;
+    double y;
+  };
+
+  //robots of equal height, sorted by x within robots_near[begin,end)
+  struct NearRobotGroup {
+    double height;
+    int begin;
+    int end;
+  };
+
+  //reused from frame to frame, so that detection does not allocate
+  std::vector<BallCandidate> candidates;
+  std::vector<NearRobot> robots_near;
+  std::vector<NearRobotGroup> robots_near_groups;
+
+  //fills robots_near and robots_near_groups with the robots of the detection frame
+  void initNearRobots(const SSL_DetectionFrame * detection_frame);
+
+  //true if the ball at pixel_pos is closer than the near robot distance to any robot
+  bool isNearRobot(const CameraParameters::Snapshot & calibration, const vector2d & pixel_pos, const vector2d & field_pos) const;
+
+  bool checkHistogram(const Image<raw8> * image, const CMVision::IntegralHistogram * integral_histogram, const CMVision::Region * reg, double min_greenness=0.5, double max_markeryness=2.0);
 
 public:
-    PluginDetectBalls(FrameBuffer * _buffer, LUT3D * lut, const CameraParameters& camera_params, const RoboCupField& field, PluginDetectBallsSettings * _settings=0);
+    PluginDetectBalls(FrameBuffer * _buffer, LUT3D * lut, const CameraParameters& camera_params, const RoboCupField& field, PluginDetectBallsSettings * _settings=0, WorkerPool * _pool=nullptr);
 
     ~PluginDetectBalls();
 
     virtual ProcessResult process(FrameData * data, RenderOptions * options);
     virtual VarList * getSettings();
     virtual string getName();
+    virtual bool usesThresholdedImage();
+    virtual bool usesBoxHistograms(int color_id);
+    virtual bool usesColorRegions(int color_id);
 };
 
 #endif
@@ -20,8 +20,8 @@
 //========================================================================
 #include "plugin_detect_robots.h"
 
-PluginDetectRobots::PluginDetectRobots(FrameBuffer * _buffer, LUT3D * lut, const CameraParameters& camera_params, const RoboCupField& field, CMPattern::TeamSelector * _global_team_selector_blue, CMPattern::TeamSelector * _global_team_selector_yellow, CMPattern::TeamDetectorSettings * _global_team_settings)
- : VisionPlugin(_buffer), camera_parameters(camera_params), field(field)
+PluginDetectRobots::PluginDetectRobots(FrameBuffer * _buffer, LUT3D * lut, const CameraParameters& camera_params, const RoboCupField& field, CMPattern::TeamSelector * _global_team_selector_blue, CMPattern::TeamSelector * _global_team_selector_yellow, CMPattern::TeamDetectorSettings * _global_team_settings, WorkerPool * _pool)
+ : VisionPlugin(_buffer), camera_parameters(camera_params), field(field), pool(_pool)
 {
   _lut=lut;
 
@@ -68,12 +68,25 @@ string PluginDetectRobots::getName() {
   return "DetectRobots";
 }
 
+bool PluginDetectRobots::usesThresholdedImage() {
+  return global_team_detector_settings->getRobotPattern()->usesHistogram();
+}
+
+bool PluginDetectRobots::usesBoxHistograms(int color_id) {
+  if (global_team_detector_settings->getRobotPattern()->usesHistogram() == false || color_id == -1) return false;
+  return color_id == color_id_blue || color_id == color_id_yellow || team_detector_blue->usesHistogramChannel(color_id);
+}
+
+bool PluginDetectRobots::usesColorRegions(int color_id) {
+  return color_id != color_id_clear && color_id != color_id_field && color_id != color_id_ball && color_id != color_id_black;
+}
+
 void PluginDetectRobots::buildRegionTree(CMVision::ColorRegionList * colorlist) {
   reg_tree.clear();
   int num_colors=colorlist->getNumColorRegions();
   for(int c=0;c<num_colors;c++) {
     //ONLY ADD ROBOT MARKER COLORS:
-    if (c!= color_id_clear && c!=color_id_field && c!= color_id_ball && c!= color_id_black) {
+    if (usesColorRegions(c)) {
       CMVision::Region *reg = colorlist->getRegionList(c).getInitialElement();
       while(reg!=0) {
         reg_tree.add(reg);
@@ -109,46 +122,57 @@ ProcessResult PluginDetectRobots::process(FrameData * data, RenderOptions * opti
     return ProcessingFailed;
   }
 
-  CMPattern::Team * team=0;
-  ::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robotlist=0;
-  
-  int color_id;
-  int num_robots;
-  CMPattern::TeamDetector * detector;
+  //the histogram checks use the integral histogram, if thresholding built one:
+  const CMVision::IntegralHistogram * integral_histogram = (CMVision::IntegralHistogram *)(data->map.get("cmv_integral_histogram"));
+  if (integral_histogram!=0 && integral_histogram->isEmpty()) integral_histogram=0;
+
+  //team 0==blue, 1==yellow
+  CMPattern::Team * teams[2];
+  ::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robotlists[2];
+  int color_ids[2] = {color_id_blue, color_id_yellow};
+  int num_robots[2];
+  CMPattern::TeamDetector * detectors[2] = {team_detector_blue, team_detector_yellow};
   //TODO: lookup color label from LUT
 
   buildRegionTree(colorlist);
   bool need_reinit=_notifier.hasChanged();
 
+  //everything touching the settings or the detection frame's layout happens here,
+  //so that the two teams below only share read-only inputs:
+  teams[0]=global_team_selector_blue->getSelectedTeam();
+  num_robots[0]=global_team_selector_blue->getNumberRobots();
+  detection_frame->clear_robots_blue();
+  robotlists[0]=detection_frame->mutable_robots_blue();
+  teams[1]=global_team_selector_yellow->getSelectedTeam();
+  num_robots[1]=global_team_selector_yellow->getNumberRobots();
+  detection_frame->clear_robots_yellow();
+  robotlists[1]=detection_frame->mutable_robots_yellow();
+
+  bool missing_team=false;
   for (int team_i = 0; team_i < 2; team_i++) {
-    //team_i: 0==blue, 1==yellow
-    if (team_i==0) {
-      color_id=color_id_blue;
-      team=global_team_selector_blue->getSelectedTeam();
-      num_robots=global_team_selector_blue->getNumberRobots();
-      detection_frame->clear_robots_blue();
-      robotlist=detection_frame->mutable_robots_blue();
-      detector=team_detector_blue;
-    } else {
-      color_id=color_id_yellow;
-      team=global_team_selector_yellow->getSelectedTeam();
-      num_robots=global_team_selector_yellow->getNumberRobots();
-      detection_frame->clear_robots_yellow();
-      robotlist=detection_frame->mutable_robots_yellow();
-      detector=team_detector_yellow;
+    if (teams[team_i]==0) {
+      missing_team=true;
+    } else if (need_reinit) {
+      detectors[team_i]->init(global_team_detector_settings->getRobotPattern(), teams[team_i]);
     }
-    if (team!=0) {
-      if (need_reinit) {
-        detector->init(global_team_detector_settings->getRobotPattern(), team);
-      }
+  }
 
-      detector->update(robotlist, color_id,  num_robots, image, colorlist, reg_tree);
-    } else {
-      _notifier.changeSlotOtherChange();
+  auto detectTeam = [&](int team_i) {
+    if (teams[team_i]!=0) {
+      detectors[team_i]->update(robotlists[team_i], color_ids[team_i], num_robots[team_i], data->video.getWidth(), data->video.getHeight(), image, colorlist, reg_tree, integral_histogram);
     }
-
-//    printf("DETECTED %d robots on team %d\n",robotlist->size(),team_i);
+//    printf("DETECTED %d robots on team %d\n",robotlists[team_i]->size(),team_i);
 //    fflush(stdout);
+  };
+
+  if (pool!=0) {
+    pool->run("DetectRobots", 2, detectTeam);
+  } else {
+    for (int team_i = 0; team_i < 2; team_i++) detectTeam(team_i);
+  }
+
+  if (missing_team) {
+    _notifier.changeSlotOtherChange();
   }
   return ProcessingOk;
 
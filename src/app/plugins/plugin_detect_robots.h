@@ -32,6 +32,7 @@
 #include "vis_util.h"
 #include "lut3d.h"
 #include "VarNotifier.h"
+#include "worker_pool.h"
 /**
 	@author Author Name
 */
@@ -63,19 +64,24 @@ protected:
 
   const CameraParameters& camera_parameters;
   const RoboCupField& field;
+  WorkerPool * pool;
 
   void buildRegionTree(CMVision::ColorRegionList * colorlist);
 
 protected slots:
     void teamDataChange();
 public:
-    PluginDetectRobots(FrameBuffer * _buffer, LUT3D * lut, const CameraParameters& camera_params, const RoboCupField& field, CMPattern::TeamSelector * _global_team_selector_blue, CMPattern::TeamSelector * _global_team_selector_yellow, CMPattern::TeamDetectorSettings * global_team_settings);
+    PluginDetectRobots(FrameBuffer * _buffer, LUT3D * lut, const CameraParameters& camera_params, const RoboCupField& field, CMPattern::TeamSelector * _global_team_selector_blue, CMPattern::TeamSelector * _global_team_selector_yellow, CMPattern::TeamDetectorSettings * global_team_settings, WorkerPool * _pool=nullptr);
 
     ~PluginDetectRobots();
 
     virtual ProcessResult process(FrameData * data, RenderOptions * options);
     virtual VarList * getSettings();
     virtual string getName();
+    virtual bool usesThresholdedImage();
+    virtual bool usesBoxHistograms(int color_id);
+    /// all robot marker colors
+    virtual bool usesColorRegions(int color_id);
 };
 
 #endif
@@ -299,6 +299,16 @@ void PluginDVR::slotMovieNew() {
 
 void PluginDVR::slotMovieLoad() {
   lock();
+  if (_file_format->getString() == "Raw Video") {
+    QString file = QFileDialog::getOpenFileName(
+        0,"Select Raw Video to Load", "", "Raw Video (*.sslraw);;All Files (*)",
+        0, QFileDialog::DontUseNativeDialog);
+    if (file!="" && stream.loadStream(file)==false) {
+      fprintf(stderr,"DVR: unable to load raw video %s\n",file.toStdString().c_str());
+    }
+    unlock();
+    return;
+  }
   // Do not use native dialog since some platforms like Windows XP and
   // Kubuntu 12.04 have very slow directory listing dialogs. The QT version is
   // pretty responsive.
@@ -342,6 +352,14 @@ void PluginDVR::slotMovieLoad() {
 
 void PluginDVR::slotMovieSave() {
   lock();
+  if (_file_format->getString() == "Raw Video") {
+    QString file = QFileDialog::getSaveFileName(0,"Select Raw Video to Save", "", "Raw Video (*.sslraw)");
+    if (file!="" && stream.saveStream(file)==false) {
+      fprintf(stderr,"DVR: unable to save raw video %s\n",file.toStdString().c_str());
+    }
+    unlock();
+    return;
+  }
   QString dir = QFileDialog::getExistingDirectory(0,"Select Directory to Save");
   rgbImage output;
   QProgressDialog * dlg = new QProgressDialog("Saving Movie to PNG Files...","Cancel", 1,stream.getFrameCount());
@@ -390,8 +408,13 @@ PluginDVR::PluginDVR(FrameBuffer * fb)
   _max_frames = new VarInt("Max Frames",250);
   _max_frames->setMin(0);
   _shift_on_exceed = new VarBool("Shift Video On Exceeding",true);
+  // raw video keeps the native pixel format and timestamps of each frame
+  _file_format = new VarStringEnum("File Format","PNG Files");
+  _file_format->addItem("PNG Files");
+  _file_format->addItem("Raw Video");
   _settings->addChild(_max_frames);
   _settings->addChild(_shift_on_exceed);
+  _settings->addChild(_file_format);
   slotModeToggled();
   slotSeekModeToggled();
 }
@@ -510,15 +533,31 @@ QWidget * PluginDVR::getControlWidget() {
 }
 
 bool DVRStream::loadStream(QString file) {
-  return false;
+  RawVideoReader reader;
+  if (reader.open(file.toStdString())==false) return false;
+  clear();
+  for (int i = 0; i < reader.getFrameCount(); i++) {
+    DVRFrame * f = new DVRFrame();
+    f->video.deepCopyFromRawImage(reader.getFrame(i),true);
+    frames.append(f);
+  }
+  return true;
 }
 
 void DVRStream::newRecording(QString directory) {
 
 }
 
-void DVRStream::saveStream(QString directory) {
-
+bool DVRStream::saveStream(QString file) {
+  RawVideoWriter writer;
+  if (writer.open(file.toStdString())==false) return false;
+  for (int i = 0; i < frames.size(); i++) {
+    if (writer.append(frames[i]->video)==false) {
+      writer.close();
+      return false;
+    }
+  }
+  return writer.close();
 }
 
 void DVRStream::clear() {
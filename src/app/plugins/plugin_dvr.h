@@ -41,6 +41,7 @@
 
 #include "timer.h"
 #include "rawimage.h"
+#include "raw_video.h"
 #include "image.h"
 #include "jog_dial.h"
 
@@ -107,7 +108,7 @@ class DVRStream
     void setLimit(int num_frames);
     bool loadStream(QString file);
     void newRecording(QString directory);
-    void saveStream(QString directory);
+    bool saveStream(QString file);
     void clear();
     void appendFrame(FrameData * data, bool shift_stream_on_limit_exceed);
     void seek(int frame);
@@ -158,6 +159,7 @@ protected:
   VarList * _settings;
   VarInt * _max_frames;
   VarBool * _shift_on_exceed;
+  VarStringEnum * _file_format;
   PluginDVRWidget * w;
 
   double advance_last_t;
@@ -20,15 +20,16 @@
 //========================================================================
 #include "plugin_find_blobs.h"
 
-PluginFindBlobs::PluginFindBlobs(FrameBuffer * _buffer, YUVLUT * _lut)
+PluginFindBlobs::PluginFindBlobs(FrameBuffer * _buffer, YUVLUT * _lut, WorkerPool * _pool)
  : VisionPlugin(_buffer)
 {
   lut=_lut;
+  pool=_pool;
 
   _settings=new VarList("Blob Finding");
   _settings->addChild(_v_min_blob_area=new VarInt("min_blob_area", 5));
   _settings->addChild(_v_enable=new VarBool("enable", true));
-  _settings->addChild(v_max_regions=new VarInt("max regions", 50000, 10000, 1000000));
+  _settings->addChild(_v_prune_colors=new VarBool("only colors in use", true));
 
 }
 
@@ -38,7 +39,7 @@ PluginFindBlobs::~PluginFindBlobs()
   delete _settings;
   delete _v_min_blob_area;
   delete _v_enable;
-  delete v_max_regions;
+  delete _v_prune_colors;
 }
 
 
@@ -47,10 +48,10 @@ ProcessResult PluginFindBlobs::process(FrameData * data, RenderOptions * options
   (void)options;
 
 
+  //the region list grows to the largest number of regions seen so far and stays allocated:
   CMVision::RegionList * reglist = (CMVision::RegionList *) data->map.get("cmv_reglist");
-  if (reglist == nullptr || reglist->getMaxRegions() != v_max_regions->getInt()) {
-    delete reglist;
-    reglist = (CMVision::RegionList *) data->map.update("cmv_reglist", new CMVision::RegionList(v_max_regions->getInt()));
+  if (reglist == nullptr) {
+    reglist = (CMVision::RegionList *) data->map.insert("cmv_reglist", new CMVision::RegionList(INITIAL_REGIONS));
   }
 
   CMVision::ColorRegionList * colorlist = (CMVision::ColorRegionList *) data->map.get("cmv_colorlist");
@@ -65,15 +66,18 @@ ProcessResult PluginFindBlobs::process(FrameData * data, RenderOptions * options
   }
 
   if (_v_enable->getBool()) {
+    //Colors no plugin reads regions of are left out, like the background:
+    const bool * used_colors = selectUsedColors(colorlist->getNumColorRegions());
+
     //Connect the components of the runlength map:
-    CMVision::RegionProcessing::connectComponents(runlist);
+    if (pool == nullptr) {
+      CMVision::RegionProcessing::connectComponents(runlist, used_colors);
+    } else {
+      CMVision::RegionProcessing::connectComponents(runlist, pool, used_colors);
+    }
   
     //Extract Regions from runlength map:
-    CMVision::RegionProcessing::extractRegions(reglist, runlist);
-  
-    if (reglist->getUsedRegions() == reglist->getMaxRegions()) {
-      printf("Warning: FindBlobs: extract regions exceeded maximum number of %d regions\n",reglist->getMaxRegions());
-    }
+    CMVision::RegionProcessing::extractRegions(reglist, runlist, used_colors);
   
     //Separate Regions by colors:
     int max_area = CMVision::RegionProcessing::separateRegions(colorlist, reglist, _v_min_blob_area->getInt());
@@ -96,6 +100,32 @@ ProcessResult PluginFindBlobs::process(FrameData * data, RenderOptions * options
 
 }
 
+void PluginFindBlobs::setColorRegionConsumers(const std::vector<VisionPlugin*> & plugins) {
+  colorRegionConsumers = plugins;
+}
+
+const bool * PluginFindBlobs::selectUsedColors(int num_colors) {
+  if (_v_prune_colors->getBool() == false || colorRegionConsumers.empty()) {
+    return nullptr;
+  }
+  usedColors[0] = false;
+  for (int c = 1; c < 256; c++) {
+    usedColors[c] = false;
+    //a color outside of the LUT's channels is still reported by separateRegions():
+    if (c >= num_colors) {
+      usedColors[c] = true;
+      continue;
+    }
+    for (VisionPlugin * plugin : colorRegionConsumers) {
+      if (plugin->usesColorRegions(c)) {
+        usedColors[c] = true;
+        break;
+      }
+    }
+  }
+  return usedColors;
+}
+
 VarList * PluginFindBlobs::getSettings() {
   return _settings;
 }
@@ -24,6 +24,7 @@
 #include <visionplugin.h>
 #include "lut3d.h"
 #include "cmvision_region.h"
+#include "worker_pool.h"
 /**
 	@author Stefan Zickler
 */
@@ -31,18 +32,30 @@ class PluginFindBlobs : public VisionPlugin
 {
 protected:
   YUVLUT * lut;
+  WorkerPool * pool;
 
   VarList * _settings;
   VarInt * _v_min_blob_area;
   VarBool * _v_enable;
-  VarInt * v_max_regions;
+  VarBool * _v_prune_colors;
+  std::vector<VisionPlugin*> colorRegionConsumers;
+  bool usedColors[256];
+
+  const bool * selectUsedColors(int num_colors);
 public:
-    PluginFindBlobs(FrameBuffer * _buffer, YUVLUT * _lut);
+    /// initial size of the region list, which grows as needed
+    static const int INITIAL_REGIONS = 50000;
+
+    /// if \p _pool is given, the components of the runs are connected in parallel
+    PluginFindBlobs(FrameBuffer * _buffer, YUVLUT * _lut, WorkerPool * _pool = nullptr);
 
     ~PluginFindBlobs() override;
 
     ProcessResult process(FrameData * data, RenderOptions * options) override;
 
+    /// the plugins whose usesColorRegions() decides which colors need regions
+    void setColorRegionConsumers(const std::vector<VisionPlugin*> & plugins);
+
     VarList * getSettings() override;
 
     string getName() override;
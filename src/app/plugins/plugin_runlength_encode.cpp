@@ -20,19 +20,15 @@
 //========================================================================
 #include "plugin_runlength_encode.h"
 
-PluginRunlengthEncode::PluginRunlengthEncode(FrameBuffer * _buffer)
- : VisionPlugin(_buffer)
+PluginRunlengthEncode::PluginRunlengthEncode(FrameBuffer * _buffer, PluginColorThreshold * _threshold,
+                                             WorkerPool * _pool)
+ : VisionPlugin(_buffer), threshold(_threshold), pool(_pool)
 {
-  settings=new VarList("Run length encode");
-  v_max_runs = new VarInt("max runs", 50000, 10000, 1000000);
-  settings->addChild(v_max_runs);
 }
 
 
 PluginRunlengthEncode::~PluginRunlengthEncode()
 {
-  delete settings;
-  delete v_max_runs;
 }
 
 
@@ -40,32 +36,45 @@ PluginRunlengthEncode::~PluginRunlengthEncode()
 ProcessResult PluginRunlengthEncode::process(FrameData * data, RenderOptions * options) {
   (void)options;
 
+  //the run list grows to the largest number of runs seen so far and stays allocated:
   CMVision::RunList * runlist = (CMVision::RunList *) data->map.get("cmv_runlist");
-  if (runlist == nullptr || runlist->getMaxRuns() != v_max_runs->get()) {
-    delete runlist;
-    runlist = (CMVision::RunList *) data->map.update("cmv_runlist", new CMVision::RunList(v_max_runs->getInt()));
+  if (runlist == nullptr) {
+    runlist = (CMVision::RunList *) data->map.insert("cmv_runlist", new CMVision::RunList(INITIAL_RUNS));
   }
 
-  Image<raw8> * img_thresholded = (Image<raw8> *) data->map.get("cmv_threshold");
-  if (img_thresholded == nullptr) {
-    printf("Runlength encoder: no thresholded input image found!\n");
-    return ProcessingFailed;
-  }
+  if (threshold != nullptr && threshold->hasWrittenThresholdedImage() == false) {
+    //Threshold and runlength encode in one pass:
+    if (threshold->thresholdAndEncodeRuns(data, runlist) == false) {
+      return ProcessingFailed;
+    }
+  } else {
+    Image<raw8> * img_thresholded = (Image<raw8> *) data->map.get("cmv_threshold");
+    if (img_thresholded == nullptr) {
+      printf("Runlength encoder: no thresholded input image found!\n");
+      return ProcessingFailed;
+    }
 
-  //Runlength Encode the image:
-  CMVision::RegionProcessing::encodeRuns(img_thresholded, runlist);
-  if (runlist->getUsedRuns() == runlist->getMaxRuns()) {
-    printf("Warning: runlength encoder exceeded current max run size of %d\n",runlist->getMaxRuns());
+    //Runlength Encode the image:
+    if (pool == nullptr || pool->getConcurrency() == 1) {
+      CMVision::RegionProcessing::encodeRuns(img_thresholded, runlist);
+    } else {
+      //each band into its own segment, then join them in row order:
+      int height = img_thresholded->getHeight();
+      int num_bands = pool->getConcurrency();
+      bands.setup(num_bands, INITIAL_RUNS / num_bands);
+      pool->run("RunlengthEncode", num_bands, [&](int band) {
+        int row_begin, row_end;
+        WorkerPool::splitRange(height, num_bands, band, row_begin, row_end);
+        CMVision::RegionProcessing::encodeRuns(img_thresholded, bands.getSegment(band), row_begin, row_end);
+      });
+      bands.join(runlist);
+    }
   }
 
   return ProcessingOk;
 
 }
 
-VarList * PluginRunlengthEncode::getSettings() {
-  return settings;
-}
-
 string PluginRunlengthEncode::getName() {
   return "RunlengthEncode";
 }
@@ -23,6 +23,7 @@
 
 #include <visionplugin.h>
 #include "cmvision_region.h"
+#include "plugin_colorthreshold.h"
 #include "timer.h"
 
 /**
@@ -31,17 +32,23 @@
 class PluginRunlengthEncode : public VisionPlugin
 {
 protected:
-  VarList * settings;
-  VarInt * v_max_runs;
+  PluginColorThreshold * threshold;
+  WorkerPool * pool;
+  CMVision::BandedRunList bands;
 public:
-    explicit PluginRunlengthEncode(FrameBuffer * _buffer);
+    /// initial size of the run list, which grows as needed
+    static const int INITIAL_RUNS = 50000;
+
+    /// if \p _threshold is given, frames it did not write a thresholded image for are
+    /// thresholded and encoded in one pass (see PluginColorThreshold::thresholdAndEncodeRuns()).
+    /// If \p _pool is given, the bands of the image are encoded in parallel.
+    explicit PluginRunlengthEncode(FrameBuffer * _buffer, PluginColorThreshold * _threshold = nullptr,
+                                   WorkerPool * _pool = nullptr);
 
     ~PluginRunlengthEncode() override;
 
     ProcessResult process(FrameData * data, RenderOptions * options) override;
 
-    VarList * getSettings() override;
-
     string getName() override;
 };
 
@@ -77,6 +77,15 @@ string PluginVisualize::getName() {
   return "Visualization";
 }
 
+bool PluginVisualize::usesThresholdedImage() {
+  return _threshold_lut != 0 && _v_enabled->getBool() && _v_thresholded->getBool();
+}
+
+bool PluginVisualize::usesColorRegions(int color_id) {
+  (void)color_id;
+  return _v_enabled->getBool() && _v_blobs->getBool();
+}
+
 void PluginVisualize::DrawCameraImage(
     FrameData* data, VisualizationFrame* vis_frame) {
   //if converting entire image then blanking is not needed
@@ -91,9 +100,10 @@ void PluginVisualize::DrawCameraImage(
         reinterpret_cast<unsigned char*>(vis_frame->data.getData()),
         data->video.getWidth(), data->video.getHeight());
   } else if (source_format==COLOR_RAW8) {
-    cv::Mat src(data->video.getWidth(), data->video.getHeight(), CV_8UC1, data->video.getData());
-    cv::Mat dst(data->video.getWidth(), data->video.getHeight(), CV_8UC3, vis_frame->data.getData());
-    cvtColor(src, dst, cv::COLOR_BayerBG2BGR);
+    //bayer frames are only demosaiced here, for display
+    cv::Mat src(data->video.getHeight(), data->video.getWidth(), CV_8UC1, data->video.getData());
+    cv::Mat dst(data->video.getHeight(), data->video.getWidth(), CV_8UC3, vis_frame->data.getData());
+    cvtColor(src, dst, cv::COLOR_BayerBG2RGB);
   } else {
     //blank it:
     vis_frame->data.fillBlack();
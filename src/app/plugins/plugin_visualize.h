@@ -118,6 +118,8 @@ public:
    virtual ProcessResult process(FrameData * data, RenderOptions * options);
    virtual VarList * getSettings();
    virtual string getName();
+   virtual bool usesThresholdedImage();
+   virtual bool usesColorRegions(int color_id);
 };
 
 #endif
@@ -76,6 +76,20 @@ void VisionPlugin::setSharedAmongStacks(bool enable) {
   shared=enable;
 }
 
+bool VisionPlugin::usesThresholdedImage() {
+  return false;
+}
+
+bool VisionPlugin::usesBoxHistograms(int color_id) {
+  (void)color_id;
+  return false;
+}
+
+bool VisionPlugin::usesColorRegions(int color_id) {
+  (void)color_id;
+  return false;
+}
+
 void VisionPlugin::displayLoopEvent(bool frame_changed, RenderOptions * opts) {
   (void)frame_changed;
   (void)opts;
@@ -93,6 +93,22 @@ public:
     virtual bool isSharedAmongStacks() const;
     virtual void setSharedAmongStacks(bool enable);
 
+    /// indicates whether process() will read the color-thresholded image ("cmv_threshold")
+    /// of the current frame. Thresholding may skip writing that image if no plugin needs it,
+    /// and leaves it empty then. This is decided once per frame, before process() runs, so
+    /// process() has to check for an empty image if its answer may have changed since.
+    virtual bool usesThresholdedImage();
+
+    /// indicates whether process() will read the counts of the color channel \p color_id in
+    /// box histograms of the color-thresholded image. Thresholding can provide those as an
+    /// integral histogram ("cmv_integral_histogram") of the channels that plugins read.
+    /// A plugin returning true must also return true from usesThresholdedImage().
+    virtual bool usesBoxHistograms(int color_id);
+
+    /// indicates whether process() will read the regions ("cmv_colorlist") of the color
+    /// channel \p color_id. Blob finding may skip the channels no plugin needs.
+    virtual bool usesColorRegions(int color_id);
+
     /// this function will be called about many times/s on your plugin
     /// in most cases you might want to only trigger a render if frame_changed==true
     /// which should occur with the same frequency as your camera input
@@ -20,6 +20,7 @@
 //========================================================================
 #include "multistack_robocup_ssl.h"
 #include "capture_splitter.h"
+#include "capture_generator.h"
 #include "DistributorStack.h"
 
 MultiStackRoboCupSSL::MultiStackRoboCupSSL(RenderOptions *_opts, int num_normal_camera_threads) :
@@ -97,8 +98,9 @@ MultiStackRoboCupSSL::MultiStackRoboCupSSL(RenderOptions *_opts, int num_normal_
     //      data instead of assuming that format and size is uniform across
     //      cameras -- added when LUTs became aware of other cameras (Zavesky, 2/16)
     threads[i]->setFrameBuffer(new FrameBuffer(3));
+    StackRoboCupSSL * stack;
     threads[i]->setStack(
-        new StackRoboCupSSL(
+        stack = new StackRoboCupSSL(
             _opts,threads[i]->getFrameBuffer(),
             i,
             global_field,
@@ -111,6 +113,11 @@ MultiStackRoboCupSSL::MultiStackRoboCupSSL(RenderOptions *_opts, int num_normal_
             ds_udp_server_new,
             ds_udp_server_old,
             "robocup-ssl-cam-" + QString::number(i).toStdString()));
+    //let the image generator render synthetic scenes through this camera's calibration
+    CaptureGenerator * generator = dynamic_cast<CaptureGenerator*>(threads[i]->getCaptureGenerator());
+    if (generator != 0) {
+      generator->setSceneContext(stack->getCameraParameters(), global_field);
+    }
   }
 
 #ifdef CAMERA_SPLITTER
@@ -54,6 +54,9 @@ StackRoboCupSSL::StackRoboCupSSL(
   _image_mask = new ConvexHullImageMask(cam_settings_filename + "-mask.xml");
   settings->addChild(_image_mask->getSettings());
 
+  worker_pool = new WorkerPool();
+  settings->addChild(worker_pool->getSettings());
+
   _global_plugin_publish_geometry->addCameraParameters(camera_parameters);
   _legacy_plugin_publish_geometry->addCameraParameters(camera_parameters);
 
@@ -68,15 +71,17 @@ StackRoboCupSSL::StackRoboCupSSL(
 
   stack.push_back(new PluginCameraCalibration(_fb,*camera_parameters, *global_field));
 
-  stack.push_back(new PluginColorThreshold(_fb,lut_yuv, *_image_mask));
+  auto *pluginColorThreshold = new PluginColorThreshold(_fb,lut_yuv, *_image_mask, worker_pool);
+  stack.push_back(pluginColorThreshold);
 
-  stack.push_back(new PluginRunlengthEncode(_fb));
+  stack.push_back(new PluginRunlengthEncode(_fb, pluginColorThreshold, worker_pool));
 
-  stack.push_back(new PluginFindBlobs(_fb,lut_yuv));
+  auto *pluginFindBlobs = new PluginFindBlobs(_fb,lut_yuv,worker_pool);
+  stack.push_back(pluginFindBlobs);
 
-  stack.push_back(new PluginDetectRobots(_fb,lut_yuv,*camera_parameters,*global_field,global_team_selector_blue,global_team_selector_yellow, global_team_settings));
+  stack.push_back(new PluginDetectRobots(_fb,lut_yuv,*camera_parameters,*global_field,global_team_selector_blue,global_team_selector_yellow, global_team_settings, worker_pool));
 
-  stack.push_back(new PluginDetectBalls(_fb,lut_yuv,*camera_parameters,*global_field,global_ball_settings));
+  stack.push_back(new PluginDetectBalls(_fb,lut_yuv,*camera_parameters,*global_field,global_ball_settings,worker_pool));
 
   stack.push_back(new PluginAutoColorCalibration(_fb,lut_yuv, (LUTWidget*) pluginColorCalibration->getControlWidget()));
 
@@ -98,6 +103,9 @@ StackRoboCupSSL::StackRoboCupSSL(
   PluginVisualize * vis = new PluginVisualize(_fb,*camera_parameters,*global_field, *_image_mask);
   vis->setThresholdingLUT(lut_yuv);
   stack.push_back(vis);
+
+  pluginColorThreshold->setThresholdedImageConsumers(stack);
+  pluginFindBlobs->setColorRegionConsumers(stack);
 }
 string StackRoboCupSSL::getSettingsFileName() {
   return _cam_settings_filename;
@@ -105,5 +113,6 @@ string StackRoboCupSSL::getSettingsFileName() {
 StackRoboCupSSL::~StackRoboCupSSL() {
   delete lut_yuv;
   delete camera_parameters;
+  delete worker_pool;
 }
 
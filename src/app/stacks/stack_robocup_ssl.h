@@ -44,6 +44,7 @@
 #include "robocup_ssl_server.h"
 #include "convex_hull_image_mask.h"
 #include "plugin_mask.h"
+#include "worker_pool.h"
 
 using namespace std;
 
@@ -61,6 +62,7 @@ class StackRoboCupSSL : public VisionStack {
   CameraParameters* camera_parameters;
   RoboCupField * global_field;
   ConvexHullImageMask *_image_mask;
+  WorkerPool * worker_pool;
   PluginDetectBallsSettings * global_ball_settings;
   CMPattern::TeamDetectorSettings * global_team_settings;
   CMPattern::TeamSelector * global_team_selector_blue;
@@ -84,6 +86,7 @@ class StackRoboCupSSL : public VisionStack {
                   RoboCupSSLServer* ds_udp_server_old,
                   string cam_settings_filename);
   virtual string getSettingsFileName();
+  CameraParameters* getCameraParameters() {return camera_parameters;};
   virtual ~StackRoboCupSSL();
 };
 
@@ -0,0 +1,177 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    main.cpp
+  \brief   Checks the parallel connected component labeling of CMVision
+           against the serial one.
+
+  Label images are taken from the team pattern images (or the images given
+  on the command line) and generated at random. Every image is labeled by
+  the serial RegionProcessing::connectComponents() and by the parallel one
+  with several thread counts, with and without a selection of used colors.
+  The check fails on the first run whose parent differs.
+*/
+//========================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "image.h"
+#include "cmvision_region.h"
+#include "worker_pool.h"
+#include "VarTypes.h"
+
+static const int MAX_THREADS = 8;
+
+static const char * default_images[] = {
+  "patterns/teams/standard2010.png",
+  "patterns/teams/standard2010_16.png",
+  "patterns/teams/cmdragons.png",
+  "patterns/teams/skuba.png",
+  0
+};
+
+// labels of a recorded image: the color quantized to two bits per channel
+static bool loadLabels(const std::string & filename, Image<raw8> & labels) {
+  rgbImage image;
+  if (image.load(filename) == false) {
+    return false;
+  }
+  labels.allocate(image.getWidth(), image.getHeight());
+  const rgb * src = image.getPixelData();
+  raw8 * dst = labels.getPixelData();
+  for (int i = 0; i < image.getNumPixels(); i++) {
+    dst[i].v = ((src[i].r >> 6) << 4) | ((src[i].g >> 6) << 2) | (src[i].b >> 6);
+  }
+  return true;
+}
+
+// random boxes of few colors on a background, with some pixel noise
+static void randomLabels(Image<raw8> & labels, int width, int height, int num_colors) {
+  labels.allocate(width, height);
+  raw8 * data = labels.getPixelData();
+  for (int i = 0; i < width * height; i++) {
+    data[i].v = 0;
+  }
+  int num_boxes = 1 + (width * height) / 200;
+  for (int b = 0; b < num_boxes; b++) {
+    int x1 = rand() % width;
+    int y1 = rand() % height;
+    int x2 = std::min(width - 1, x1 + rand() % 30);
+    int y2 = std::min(height - 1, y1 + rand() % 30);
+    unsigned char color = rand() % num_colors;
+    for (int y = y1; y <= y2; y++) {
+      for (int x = x1; x <= x2; x++) {
+        data[y * width + x].v = color;
+      }
+    }
+  }
+  for (int i = 0; i < width * height / 20; i++) {
+    data[rand() % (width * height)].v = rand() % num_colors;
+  }
+}
+
+static bool checkLabeling(const std::string & name, Image<raw8> & labels, WorkerPool & pool, VarInt * threads,
+                          const bool * used_colors) {
+  CMVision::RunList expected(labels.getWidth() + 1);
+  CMVision::RunList runlist(labels.getWidth() + 1);
+  CMVision::RegionProcessing::encodeRuns(&labels, &expected);
+  CMVision::RegionProcessing::connectComponents(&expected, used_colors);
+
+  for (int n = 0; n < MAX_THREADS; n++) {
+    threads->setInt(n);
+    CMVision::RegionProcessing::encodeRuns(&labels, &runlist);
+    CMVision::RegionProcessing::connectComponents(&runlist, &pool, used_colors);
+    if (runlist.getUsedRuns() != expected.getUsedRuns()) {
+      fprintf(stderr, "%s, %d threads: %d runs instead of %d\n",
+              name.c_str(), n + 1, runlist.getUsedRuns(), expected.getUsedRuns());
+      return false;
+    }
+    const CMVision::Run * runs = runlist.getRunArrayPointer();
+    const CMVision::Run * expected_runs = expected.getRunArrayPointer();
+    for (int i = 0; i < runlist.getUsedRuns(); i++) {
+      if (runs[i].parent != expected_runs[i].parent) {
+        fprintf(stderr, "%s, %d threads%s: run %d (x=%d y=%d) has parent %d instead of %d\n",
+                name.c_str(), n + 1, used_colors ? ", selected colors" : "", i,
+                runs[i].x, runs[i].y, runs[i].parent, expected_runs[i].parent);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// checks an image with all colors, and with every other color left out
+static bool checkImage(const std::string & name, Image<raw8> & labels, WorkerPool & pool, VarInt * threads) {
+  bool used_colors[256];
+  for (int c = 0; c < 256; c++) {
+    used_colors[c] = (c % 2 == 1);
+  }
+  return checkLabeling(name, labels, pool, threads, 0) &&
+         checkLabeling(name, labels, pool, threads, used_colors);
+}
+
+int main(int argc, char ** argv) {
+  WorkerPool pool;
+  VarInt * threads = (VarInt *) pool.getSettings()->findChild("number of threads");
+  if (threads == 0) {
+    fprintf(stderr, "Worker pool has no thread setting\n");
+    return 1;
+  }
+
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    files.push_back(argv[i]);
+  }
+  if (files.empty()) {
+    for (int i = 0; default_images[i] != 0; i++) {
+      files.push_back(default_images[i]);
+    }
+  }
+
+  Image<raw8> labels;
+  int num_checked = 0;
+  for (unsigned int i = 0; i < files.size(); i++) {
+    if (loadLabels(files[i], labels) == false) {
+      fprintf(stderr, "Unable to load '%s', skipping it\n", files[i].c_str());
+      continue;
+    }
+    if (checkImage(files[i], labels, pool, threads) == false) {
+      return 1;
+    }
+    num_checked++;
+  }
+
+  // random images, including ones with fewer rows than threads:
+  srand(1);
+  const int sizes[][2] = { {640, 480}, {1, 1}, {7, 3}, {33, 5}, {100, 1}, {1, 100}, {257, 129} };
+  const int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+  for (int i = 0; i < 50; i++) {
+    int width = sizes[i % num_sizes][0];
+    int height = sizes[i % num_sizes][1];
+    randomLabels(labels, width, height, 2 + i % 6);
+    char name[64];
+    snprintf(name, sizeof(name), "random image %d (%dx%d)", i, width, height);
+    if (checkImage(name, labels, pool, threads) == false) {
+      return 1;
+    }
+    num_checked++;
+  }
+
+  threads->setInt(0);
+  printf("Parallel labeling matches serial labeling on %d images\n", num_checked);
+  return 0;
+}
@@ -34,7 +34,6 @@ CaptureBasler::CaptureBasler(VarList* _settings, QObject* parent) :
 	ignore_capture_failure = false;
 	converter.OutputPixelFormat = Pylon::PixelType_RGB8packed;
 	//camera.PixelFormat.SetValue(Basler_GigECamera::PixelFormat_YUV422Packed, true);
-	last_buf = NULL;
 
 	settings->addChild(vars = new VarList("Capture Settings"));
 	settings->removeFlags(VARTYPE_FLAG_HIDE_CHILDREN);
@@ -43,6 +42,7 @@ CaptureBasler::CaptureBasler(VarList* _settings, QObject* parent) :
 			Colors::colorFormatToString(COLOR_RGB8));
 	v_color_mode->addItem(Colors::colorFormatToString(COLOR_YUV422_UYVY));
 	v_color_mode->addItem(Colors::colorFormatToString(COLOR_RGB8));
+	v_color_mode->addItem(Colors::colorFormatToString(COLOR_RAW8));
 	vars->addChild(v_color_mode);
 
 	vars->addChild(v_camera_id = new VarInt("Camera ID", 0, 0, 3));
@@ -165,17 +165,8 @@ bool CaptureBasler::stopCapture() {
 }
 
 void CaptureBasler::releaseFrame() {
-	MUTEX_LOCK;
-	try {
-		if (last_buf) {
-			free(last_buf);
-			last_buf = NULL;
-		}
-	} catch (...) {
-		MUTEX_UNLOCK;
-		throw;
-	}
-	MUTEX_UNLOCK;
+	// The converted image is owned by the lease of the RawImage returned
+	// by getFrame() and freed together with its last copy.
 }
 
 RawImage CaptureBasler::getFrame() {
@@ -221,20 +212,40 @@ RawImage CaptureBasler::getFrame() {
 			MUTEX_UNLOCK;
 			return img;
 		}
-		Pylon::CPylonImage capture;
+		if (Colors::stringToColorFormat(v_color_mode->getSelection().c_str()) == COLOR_RAW8) {
+			if (grab_result->GetPixelType() == Pylon::PixelType_BayerRG8) {
+				// Pass the bayer mosaic on untouched: it is thresholded
+				// directly and only demosaiced for visualization.
+				// The copied grab result keeps the driver buffer queued
+				// out until the last RawImage referring to it is gone.
+				std::shared_ptr<Pylon::CGrabResultPtr> raw =
+						std::make_shared<Pylon::CGrabResultPtr>(grab_result);
+				img.lend((unsigned char*) (*raw)->GetBuffer(), COLOR_RAW8,
+						(*raw)->GetWidth(), (*raw)->GetHeight(), raw);
+				grab_result.Release();
+				MUTEX_UNLOCK;
+				return img;
+			}
+			static bool warned = false;
+			if (!warned) {
+				fprintf(stderr,
+						"CaptureBasler: camera does not deliver BayerRG8, converting to RGB8 instead\n");
+				warned = true;
+			}
+		}
 
-		// Convert to RGB8 format
-		converter.Convert(capture, grab_result);
+		std::shared_ptr<Pylon::CPylonImage> capture =
+				std::make_shared<Pylon::CPylonImage>();
 
-		img.setWidth(capture.GetWidth());
-		img.setHeight(capture.GetHeight());
-		unsigned char* buf = (unsigned char*) malloc(capture.GetImageSize());
-		memcpy(buf, capture.GetBuffer(), capture.GetImageSize());
-		img.setData(buf);
+		// Convert to RGB8 format
+		converter.Convert(*capture, grab_result);
 
-		last_buf = buf;
+		// The converted image keeps its buffer alive for as long as
+		// any RawImage (e.g. a FrameBuffer slot) still refers to it.
+		img.lend((unsigned char*) capture->GetBuffer(), COLOR_RGB8,
+				capture->GetWidth(), capture->GetHeight(), capture);
 
-		// Original buffer is not needed anymore, it has been copied to img
+		// Original buffer is not needed anymore, it has been converted to img
 		grab_result.Release();
 	} catch (Pylon::GenericException& e) {
 		fprintf(stderr, "Exception while grabbing a frame: %s\n", e.what());
@@ -258,7 +269,7 @@ bool CaptureBasler::copyAndConvertFrame(const RawImage & src,
 		RawImage & target) {
 	MUTEX_LOCK;
 	try {
-		target.ensure_allocation(COLOR_RGB8, src.getWidth(), src.getHeight());
+		target.ensure_allocation(src.getColorFormat(), src.getWidth(), src.getHeight());
 		target.setTime(src.getTime());
 		memcpy(target.getData(), src.getData(), src.getNumBytes());
 	} catch (...) {
@@ -269,6 +280,14 @@ bool CaptureBasler::copyAndConvertFrame(const RawImage & src,
 	return true;
 }
 
+bool CaptureBasler::lendFrame(const RawImage & src, RawImage & target) {
+	if ((src.getColorFormat() != COLOR_RGB8 && src.getColorFormat() != COLOR_RAW8)
+			|| src.getData() == 0) {
+		return false;
+	}
+	return target.lend(src);
+}
+
 void CaptureBasler::readAllParameterValues() {
 	MUTEX_LOCK;
 	try {
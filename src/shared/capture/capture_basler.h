@@ -57,6 +57,8 @@ public:
 
 	bool copyAndConvertFrame(const RawImage & src, RawImage & target);
 
+	bool lendFrame(const RawImage & src, RawImage & target);
+
 	void readAllParameterValues();
 
 	void writeParameterValues(VarList* vars);
@@ -68,7 +70,6 @@ private:
 	Pylon::CGrabResultPtr grab_result;
 	Pylon::CImageFormatConverter converter;
 	int current_id;
-  	unsigned char* last_buf;
 
   	VarList* vars;
   	VarInt* v_camera_id;
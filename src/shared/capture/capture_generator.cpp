@@ -40,10 +40,25 @@ CaptureGenerator::CaptureGenerator ( VarList * _settings, QObject * parent ) : Q
   capture_settings->addChild ( v_width = new VarInt ( "Width (pixels)", 780 ) );
   capture_settings->addChild ( v_height = new VarInt ( "Height (pixels)", 580 ) );
   capture_settings->addChild ( v_test_image = new VarBool ( "Generate Color Test Image", false ) );
+
+  scene = new SyntheticScene ( capture_settings );
 }
 
 CaptureGenerator::~CaptureGenerator()
 {
+  delete scene;
+}
+
+void CaptureGenerator::setSceneContext ( const CameraParameters * camera, const RoboCupField * field )
+{
+  mutex.lock();
+  scene->setContext ( camera, field );
+  mutex.unlock();
+}
+
+SyntheticScene::GroundTruth CaptureGenerator::getSceneGroundTruth()
+{
+  return scene->getGroundTruth();
 }
 
 bool CaptureGenerator::stopCapture()
@@ -63,6 +78,8 @@ bool CaptureGenerator::startCapture()
 {
   mutex.lock();
   limit.init ( v_framerate->getDouble() );
+  //every capture run replays the scene from its seed
+  scene->reset();
   is_capturing=true;
 
 
@@ -103,17 +120,30 @@ bool CaptureGenerator::copyAndConvertFrame ( const RawImage & src, RawImage & ta
   return true;
 }
 
+bool CaptureGenerator::lendFrame ( const RawImage & src, RawImage & target )
+{
+  mutex.lock();
+  ColorFormat output_fmt = Colors::stringToColorFormat ( v_colorout->getSelection().c_str() );
+  bool lent = ( output_fmt == src.getColorFormat() ) && target.lend ( src );
+  mutex.unlock();
+  return lent;
+}
+
 RawImage CaptureGenerator::getFrame()
 {
   mutex.lock();
   limit.waitForNextFrame();
   result.setColorFormat ( COLOR_RGB8 );
   result.setTime ( GetTimeSec() );
-  result.allocate ( COLOR_RGB8,v_width->getInt(),v_height->getInt() );
+  //a fresh shared buffer per frame, so frames can be lent without copying
+  result.allocateShared ( COLOR_RGB8,v_width->getInt(),v_height->getInt() );
   rgbImage img;
   img.fromRawImage(result);
 
-  if (v_test_image->getBool()) {
+  if (scene->isEnabled() && scene->hasContext()) {
+    scene->update ( result.getTime(), 1.0 / max ( 1.0, v_framerate->getDouble() ) );
+    scene->render ( img );
+  } else if (v_test_image->getBool()) {
     int w = result.getWidth();
     int h = result.getHeight();
     int n_colors = 8;
@@ -28,6 +28,7 @@
 #include "framecounter.h"
 #include "framelimiter.h"
 #include "image.h"
+#include "synthetic_scene.h"
   #include <QMutex>
 
 
@@ -56,6 +57,8 @@ protected:
   VarInt * v_height;
   VarDouble * v_framerate;
   VarBool * v_test_image;
+
+  SyntheticScene * scene;
   
 public:
   CaptureGenerator(VarList * _settings, QObject * parent=0);
@@ -72,7 +75,13 @@ public:
   void cleanup();
 
   virtual bool copyAndConvertFrame(const RawImage & src, RawImage & target);
+  virtual bool lendFrame(const RawImage & src, RawImage & target);
   virtual string getCaptureMethodName() const;
+
+  /// provides the camera model and field geometry for rendering synthetic scenes
+  void setSceneContext(const CameraParameters * camera, const RoboCupField * field);
+  /// ground truth of the most recently generated scene frame
+  SyntheticScene::GroundTruth getSceneGroundTruth();
 };
 
 #endif
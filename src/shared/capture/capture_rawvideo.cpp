@@ -0,0 +1,179 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    capture_rawvideo.cpp
+  \brief   C++ Implementation: CaptureRawVideo
+*/
+//========================================================================
+
+#include "capture_rawvideo.h"
+#include "conversions.h"
+#include "timer.h"
+#include <unistd.h>
+#include <opencv2/opencv.hpp>
+
+CaptureRawVideo::CaptureRawVideo(VarList * _settings, QObject * parent) : QObject(parent), CaptureInterface(_settings)
+{
+  is_capturing=false;
+  current_frame=0;
+  playback_start_wall=0.0;
+  playback_start_recorded=0.0;
+
+  settings->addChild(conversion_settings = new VarList("Conversion Settings"));
+  settings->addChild(capture_settings = new VarList("Capture Settings"));
+
+  //=======================CONVERSION SETTINGS=======================
+  conversion_settings->addChild(v_colorout=new VarStringEnum("convert to mode",Colors::colorFormatToString(COLOR_YUV422_UYVY)));
+  v_colorout->addItem(Colors::colorFormatToString(COLOR_RGB8));
+  v_colorout->addItem(Colors::colorFormatToString(COLOR_YUV422_UYVY));
+  v_colorout->addItem(Colors::colorFormatToString(COLOR_RAW8));
+
+  //=======================CAPTURE SETTINGS==========================
+  capture_settings->addChild(v_file = new VarString("file", "test-data/recording.sslraw"));
+  capture_settings->addChild(v_rate = new VarStringEnum("playback rate", "original"));
+  v_rate->addItem("original");
+  v_rate->addItem("unlimited");
+  capture_settings->addChild(v_start_frame = new VarInt("start frame", 0, 0));
+  capture_settings->addChild(v_loop = new VarBool("loop", true));
+  // recorded timestamps make replays reproducible, current time keeps the rest of the system happy
+  capture_settings->addChild(v_recorded_time = new VarBool("use recorded timestamps", false));
+}
+
+CaptureRawVideo::~CaptureRawVideo()
+{
+}
+
+bool CaptureRawVideo::stopCapture()
+{
+  cleanup();
+  return true;
+}
+
+void CaptureRawVideo::cleanup()
+{
+  mutex.lock();
+  is_capturing=false;
+  reader.close();
+  mutex.unlock();
+}
+
+bool CaptureRawVideo::startCapture()
+{
+  mutex.lock();
+  if (!reader.open(v_file->getString()) || reader.getFrameCount()==0) {
+    fprintf(stderr,"CaptureRawVideo: no frames available in %s\n",v_file->getString().c_str());
+    reader.close();
+    is_capturing=false;
+    mutex.unlock();
+    return false;
+  }
+  current_frame=v_start_frame->getInt();
+  if (current_frame >= reader.getFrameCount()) current_frame=0;
+  playback_start_wall=GetTimeSec();
+  playback_start_recorded=reader.getTime(current_frame);
+  is_capturing=true;
+  mutex.unlock();
+  return true;
+}
+
+RawImage CaptureRawVideo::getFrame()
+{
+  mutex.lock();
+  RawImage result;
+  if (is_capturing==false) {
+    mutex.unlock();
+    return result;
+  }
+
+  if (current_frame >= reader.getFrameCount()) {
+    if (v_loop->getBool()==false) {
+      is_capturing=false;
+      mutex.unlock();
+      return result;
+    }
+    current_frame=0;
+    playback_start_wall=GetTimeSec();
+    playback_start_recorded=reader.getTime(0);
+  }
+
+  if (v_rate->getString()=="original") {
+    //wait until this frame is due, relative to where playback started
+    double due=playback_start_wall + (reader.getTime(current_frame) - playback_start_recorded);
+    double wait=due - GetTimeSec();
+    if (wait > 0.0 && wait < 10.0) {
+      usleep((useconds_t)(wait*1e6));
+    }
+  }
+
+  result=reader.getFrame(current_frame);
+  current_frame++;
+  if (v_recorded_time->getBool()==false) {
+    result.setTime(GetTimeSec());
+  }
+  mutex.unlock();
+  return result;
+}
+
+void CaptureRawVideo::releaseFrame()
+{
+  //frames borrow the file mapping, nothing to release here
+}
+
+bool CaptureRawVideo::lendFrame(const RawImage & src, RawImage & target)
+{
+  mutex.lock();
+  ColorFormat output_fmt = Colors::stringToColorFormat(v_colorout->getSelection().c_str());
+  bool lent = (output_fmt == src.getColorFormat()) && target.lend(src);
+  mutex.unlock();
+  return lent;
+}
+
+bool CaptureRawVideo::copyAndConvertFrame(const RawImage & src, RawImage & target)
+{
+  mutex.lock();
+  ColorFormat output_fmt = Colors::stringToColorFormat(v_colorout->getSelection().c_str());
+  ColorFormat src_fmt = src.getColorFormat();
+
+  if (src.getData()==0) {
+    mutex.unlock();
+    return false;
+  }
+  target.ensure_allocation(output_fmt, src.getWidth(), src.getHeight());
+  target.setTime(src.getTime());
+  if (output_fmt == src_fmt) {
+    memcpy(target.getData(), src.getData(), static_cast<size_t>(src.getNumBytes()));
+  } else if (src_fmt == COLOR_RAW8 && output_fmt == COLOR_RGB8) {
+    cv::Mat srcMat(src.getHeight(), src.getWidth(), CV_8UC1, src.getData());
+    cv::Mat dstMat(target.getHeight(), target.getWidth(), CV_8UC3, target.getData());
+    cvtColor(srcMat, dstMat, cv::COLOR_BayerRG2BGR);
+  } else if (src_fmt == COLOR_YUV422_UYVY && output_fmt == COLOR_RGB8) {
+    Conversions::uyvy2rgb(src.getData(), target.getData(), src.getWidth(), src.getHeight());
+  } else if (src_fmt == COLOR_RGB8 && output_fmt == COLOR_YUV422_UYVY) {
+    Conversions::rgb2uyvy(src.getData(), target.getData(), src.getWidth(), src.getHeight());
+  } else {
+    fprintf(stderr,"Cannot copy and convert frame...unknown conversion selected from: %s to %s\n",
+            Colors::colorFormatToString(src_fmt).c_str(),
+            Colors::colorFormatToString(output_fmt).c_str());
+    mutex.unlock();
+    return false;
+  }
+  mutex.unlock();
+  return true;
+}
+
+string CaptureRawVideo::getCaptureMethodName() const
+{
+  return "RawVideo";
+}
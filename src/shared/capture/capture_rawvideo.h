@@ -0,0 +1,79 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    capture_rawvideo.h
+  \brief   C++ Interface: CaptureRawVideo
+*/
+//========================================================================
+
+#ifndef CAPTURERAWVIDEO_H
+#define CAPTURERAWVIDEO_H
+
+#include "captureinterface.h"
+#include <string>
+#include "VarTypes.h"
+#include "raw_video.h"
+#include <QMutex>
+
+/*!
+  \class   CaptureRawVideo
+  \brief   Plays back a raw video file (see raw_video.h)
+
+  Frames are served straight from the memory-mapped file, either at the
+  rate they were recorded with or as fast as they are consumed.
+*/
+class CaptureRawVideo : public QObject, public CaptureInterface
+{
+  Q_OBJECT
+  protected:
+  QMutex mutex;
+
+  bool is_capturing;
+  RawVideoReader reader;
+  int current_frame;
+  double playback_start_wall;
+  double playback_start_recorded;
+
+  //processing variables:
+  VarStringEnum * v_colorout;
+
+  VarList * capture_settings;
+  VarList * conversion_settings;
+
+  VarString * v_file;
+  VarStringEnum * v_rate;
+  VarInt * v_start_frame;
+  VarBool * v_loop;
+  VarBool * v_recorded_time;
+
+public:
+  CaptureRawVideo(VarList * _settings, QObject * parent=0);
+  ~CaptureRawVideo();
+
+  virtual bool startCapture();
+  virtual bool stopCapture();
+  virtual bool isCapturing() { return is_capturing; };
+
+  virtual RawImage getFrame();
+  virtual void releaseFrame();
+
+  void cleanup();
+
+  virtual bool copyAndConvertFrame(const RawImage & src, RawImage & target);
+  virtual bool lendFrame(const RawImage & src, RawImage & target);
+  virtual string getCaptureMethodName() const;
+};
+
+#endif
@@ -49,6 +49,11 @@ CaptureSplitter::CaptureSplitter(VarList * _settings, int default_camera_id, QOb
     settings->addChild(relative_width = new VarDouble("Relative width", 1.0, 0.0, 1.0));
   }
 
+  //bayer frames can be passed on as they are, they will be thresholded directly
+  settings->addChild(v_convert_to_mode = new VarStringEnum("convert to mode", Colors::colorFormatToString(COLOR_RGB8)));
+  v_convert_to_mode->addItem(Colors::colorFormatToString(COLOR_RGB8));
+  v_convert_to_mode->addItem(Colors::colorFormatToString(COLOR_RAW8));
+
   image_buffer = new RawImage();
 }
 
@@ -117,6 +122,21 @@ bool CaptureSplitter::copyAndConvertFrame(const RawImage &src, RawImage &target)
   width -= width % 2;
   height -= height % 2;
 
+  if(src.getColorFormat() == ColorFormat::COLOR_RAW8 &&
+     Colors::stringToColorFormat(v_convert_to_mode->getSelection().c_str()) == ColorFormat::COLOR_RAW8)
+  {
+    // crop the mosaic straight into the target, no demosaicing needed
+    target.ensure_allocation(ColorFormat::COLOR_RAW8, width, height);
+    for (int i = 0; i < height; i++) {
+      memcpy(
+              target.getData() + i * width,
+              src.getData() + (i + height_offset) * src.getWidth() + width_offset,
+              (size_t) width);
+    }
+    mutex.unlock();
+    return true;
+  }
+
   // allocate target image
   image_buffer->ensure_allocation(src.getColorFormat(), width, height);
 
@@ -38,6 +38,7 @@ protected:
   VarDouble* relative_width_offset;
   VarDouble* relative_width;
   VarDouble* relative_height;
+  VarStringEnum* v_convert_to_mode;
 
   RawImage* full_image;
   RawImage* image_buffer;
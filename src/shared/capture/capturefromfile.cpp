@@ -21,6 +21,10 @@
 //========================================================================
 
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <cctype>
 #include "capturefromfile.h"
 #include "image_io.h"
@@ -30,9 +34,71 @@
 #include <opencv2/opencv.hpp>
 
 
+ImagePrefetcher::ImagePrefetcher(const std::vector<std::string> & _files, int _raw_width, int _raw_height,
+                                 int _window, int threads) :
+  files(_files), raw_width(_raw_width), raw_height(_raw_height)
+{
+  window = static_cast<unsigned long>(std::max(1, _window));
+  scheduled = 0;
+  stop = false;
+  for (int i = 0; i < std::max(1, threads); i++) {
+    workers.emplace_back(&ImagePrefetcher::work, this);
+  }
+}
+
+ImagePrefetcher::~ImagePrefetcher()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  work_cond.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void ImagePrefetcher::work()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    work_cond.wait(lock, [this] { return stop || !todo.empty(); });
+    if (stop) {
+      return;
+    }
+    unsigned long seq = todo.front();
+    todo.pop_front();
+    lock.unlock();
+    RawImage img;
+    CaptureFromFile::loadImageFile(files[seq % files.size()], raw_width, raw_height, true, img);
+    lock.lock();
+    ready[seq] = img;
+    ready_cond.notify_all();
+  }
+}
+
+RawImage ImagePrefetcher::get(unsigned long seq)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  // keep the look-ahead window filled
+  if (scheduled < seq) {
+    scheduled = seq;
+  }
+  while (scheduled < seq + window) {
+    todo.push_back(scheduled++);
+    work_cond.notify_one();
+  }
+  ready_cond.wait(lock, [this, seq] { return ready.count(seq) > 0; });
+  RawImage img = ready[seq];
+  ready.erase(seq);
+  return img;
+}
+
 CaptureFromFile::CaptureFromFile(VarList * _settings, int default_camera_id, QObject * parent) : QObject(parent), CaptureInterface(_settings)
 {
   currentImageIndex = 0;
+  prefetcher = nullptr;
+  stream_position = 0;
   is_capturing=false;
 
   settings->addChild(conversion_settings = new VarList("Conversion Settings"));
@@ -47,6 +113,12 @@ CaptureFromFile::CaptureFromFile(VarList * _settings, int default_camera_id, QOb
   conversion_settings-> addChild(v_raw_width=new VarInt("raw width", 2448));
   conversion_settings-> addChild(v_raw_height=new VarInt("raw height", 2048));
 
+  //=======================STREAMING SETTINGS========================
+  // load images on demand instead of decoding the whole directory at start
+  capture_settings->addChild(v_streaming = new VarBool("stream images", false));
+  capture_settings->addChild(v_prefetch_frames = new VarInt("prefetch frames", 8, 1, 256));
+  capture_settings->addChild(v_prefetch_threads = new VarInt("prefetch threads", 2, 1, 16));
+
   //=======================CAPTURE SETTINGS==========================
   ostringstream convert;
   convert << "test-data/cam" << default_camera_id;
@@ -62,6 +134,7 @@ CaptureFromFile::CaptureFromFile(VarList * _settings, int default_camera_id, QOb
 
 CaptureFromFile::~CaptureFromFile()
 {
+  cleanup();
 }
 
 bool CaptureFromFile::stopCapture() 
@@ -74,36 +147,129 @@ void CaptureFromFile::cleanup()
 {
   mutex.lock();
   is_capturing=false;
+  delete prefetcher;
+  prefetcher = nullptr;
   mutex.unlock();
 }
 
-bool CaptureFromFile::startCapture()
+bool CaptureFromFile::listImageFiles()
 {
-  mutex.lock();
-  if(images.size() == 0)
+  // Acquire a list of file names
+  DIR *dp;
+  struct dirent *dirp;
+  imgs_to_load.clear();
+  if((v_cap_dir->getString() == "") || ((dp  = opendir(v_cap_dir->getString().c_str())) == 0)) 
+  {
+    fprintf(stderr,"Failed to open directory %s \n", v_cap_dir->getString().c_str());
+    return false;
+  }  
+  while ((dirp = readdir(dp))) 
   {
-    // Acquire a list of file names
-    DIR *dp;
-    struct dirent *dirp;
-    if((v_cap_dir->getString() == "") || ((dp  = opendir(v_cap_dir->getString().c_str())) == 0)) 
+    if (strcmp(dirp->d_name,".") != 0 && strcmp(dirp->d_name,"..") != 0) 
     {
-      fprintf(stderr,"Failed to open directory %s \n", v_cap_dir->getString().c_str());
-      mutex.unlock();
-      is_capturing=false;
+      if(isImageFileName(std::string(dirp->d_name)))
+        imgs_to_load.push_back(v_cap_dir->getString() + "/" + std::string(dirp->d_name));
+      else
+        fprintf(stderr,"Not a valid image file: %s \n", dirp->d_name);
+    }
+  }
+  closedir(dp);
+  imgs_to_load.sort();
+  return !imgs_to_load.empty();
+}
+
+bool CaptureFromFile::loadImageFile(const std::string & fileName, int raw_width, int raw_height,
+                                    bool map_raw, RawImage & img)
+{
+  if(getFileExtension(fileName) == "RAW")
+  {
+    if(raw_width <= 0 || raw_height <= 0)
+    {
+      std::cout << "Could not read image. Dimensions must be positive." << std::endl;
+      return false;
+    }
+    size_t size = static_cast<size_t>(RawImage::computeImageSize(COLOR_RAW8, raw_width*raw_height));
+    int fd = open(fileName.c_str(), O_RDONLY);
+    struct stat st{};
+    if(fd < 0 || fstat(fd, &st) != 0)
+    {
+      std::cout << "Could not read file: " << fileName << std::endl;
+      if (fd >= 0) close(fd);
       return false;
-    }  
-    while ((dirp = readdir(dp))) 
+    }
+    if(static_cast<size_t>(st.st_size) < size)
     {
-      if (strcmp(dirp->d_name,".") != 0 && strcmp(dirp->d_name,"..") != 0) 
+      std::cerr << "Image " << fileName << " is too small!" << std::endl;
+      close(fd);
+      return false;
+    }
+    if(map_raw)
+    {
+      // private mapping: pages are read on demand and writes never reach the file
+      void * mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if(mapped == MAP_FAILED)
       {
-        if(isImageFileName(std::string(dirp->d_name)))
-          imgs_to_load.push_back(v_cap_dir->getString() + "/" + std::string(dirp->d_name));
-        else
-          fprintf(stderr,"Not a valid image file: %s \n", dirp->d_name);
+        std::cout << "Could not map file: " << fileName << std::endl;
+        return false;
       }
+      madvise(mapped, size, MADV_WILLNEED);
+      img.lend((unsigned char *) mapped, COLOR_RAW8, raw_width, raw_height,
+               std::shared_ptr<void>(mapped, [size](void * p) { munmap(p, size); }));
     }
-    closedir(dp);
-    if(imgs_to_load.size() == 0)
+    else
+    {
+      img.allocateShared(COLOR_RAW8, raw_width, raw_height);
+      ssize_t n = pread(fd, img.getData(), size, 0);
+      close(fd);
+      if(n < 0 || static_cast<size_t>(n) < size)
+      {
+        std::cout << "Could not read file: " << fileName << std::endl;
+        img.clear();
+        return false;
+      }
+    }
+  }
+  else
+  {
+    // read image to default OpenCV image format (BGR8)
+    cv::Mat srcImg = cv::imread(fileName, cv::IMREAD_COLOR);
+    if(srcImg.empty())
+    {
+      std::cout << "Could not read file: " << fileName << std::endl;
+      return false;
+    }
+    img.allocateShared(ColorFormat::COLOR_RGB8, srcImg.cols, srcImg.rows);
+    cv::Mat dstImg(img.getHeight(), img.getWidth(), CV_8UC3, img.getData());
+    // convert to default ssl-vision format (RGB8)
+    cvtColor(srcImg, dstImg, cv::COLOR_BGR2RGB);
+  }
+  return true;
+}
+
+bool CaptureFromFile::startCapture()
+{
+  mutex.lock();
+  if(v_streaming->getBool())
+  {
+    // only list the files here, they are loaded on demand by the prefetcher
+    if(prefetcher == nullptr)
+    {
+      if(!listImageFiles())
+      {
+        mutex.unlock();
+        is_capturing=false;
+        return false;
+      }
+      std::vector<std::string> files(imgs_to_load.begin(), imgs_to_load.end());
+      prefetcher = new ImagePrefetcher(files, v_raw_width->get(), v_raw_height->get(),
+                                       v_prefetch_frames->get(), v_prefetch_threads->get());
+      stream_position = 0;
+    }
+  }
+  else if(images.size() == 0)
+  {
+    if(!listImageFiles())
     {
       mutex.unlock();
       is_capturing=false;
@@ -111,48 +277,13 @@ bool CaptureFromFile::startCapture()
     }
   
     // Read images to buffer in memory:
-    imgs_to_load.sort();
     for (const auto& currentImage : imgs_to_load) {
-      int width(v_raw_width->get());
-      int height(v_raw_height->get());
-      if(getFileExtension(currentImage) == "RAW")
+      RawImage img;
+      if(!loadImageFile(currentImage, v_raw_width->get(), v_raw_height->get(), false, img))
       {
-        if(width <= 0 || height <= 0)
-        {
-          std::cout << "Could not read image. Dimensions must be positive." << std::endl;
-          continue;
-        }
-        std::ifstream file(currentImage, std::ios::binary );
-        if(!file)
-        {
-          std::cout << "Could not read file: " << currentImage << std::endl;
-          continue;
-        }
-        vector<char> buffer((istreambuf_iterator<char>(file)), (istreambuf_iterator<char>()));
-
-        if((int) buffer.size() < width*height)
-        {
-          std::cerr << "Image " << currentImage << " is too small!" << std::endl;
-          continue;
-        }
-
-        RawImage raw_img;
-        raw_img.allocate(ColorFormat::COLOR_RAW8, width, height);
-        memcpy(raw_img.getData(), buffer.data(), static_cast<size_t>(raw_img.getNumBytes()));
-
-        images.push_back(raw_img);
-      }
-      else
-      {
-        // read image to default OpenCV image format (BGR8)
-        cv::Mat srcImg = imread(currentImage, cv::IMREAD_COLOR);
-        RawImage img;
-        img.allocate(ColorFormat::COLOR_RGB8, srcImg.cols, srcImg.rows);
-        cv::Mat dstImg(img.getHeight(), img.getWidth(), CV_8UC3, img.getData());
-        // convert to default ssl-vision format (RGB8)
-        cvtColor(srcImg, dstImg, cv::COLOR_BGR2RGB);
-        images.push_back(img);
+        continue;
       }
+      images.push_back(img);
       fprintf (stderr, "Loaded %s \n", currentImage.c_str());
     }
     currentImageIndex = 0;
@@ -245,12 +376,38 @@ bool CaptureFromFile::copyAndConvertFrame(const RawImage & src, RawImage & targe
   return true;
 }
 
+bool CaptureFromFile::lendFrame(const RawImage & src, RawImage & target)
+{
+  mutex.lock();
+  ColorFormat output_fmt = Colors::stringToColorFormat(v_colorout->getSelection().c_str());
+  // the loaded images are shared buffers, so matching frames can be handed out as-is
+  bool lent = (output_fmt == src.getColorFormat()) && target.lend(src);
+  mutex.unlock();
+  return lent;
+}
+
 RawImage CaptureFromFile::getFrame()
 {
    mutex.lock();
 
   RawImage result;
-  if(images.empty())
+  if(prefetcher != nullptr)
+  {
+    // skip over files that could not be loaded
+    for(unsigned long i = 0; i < prefetcher->size(); i++)
+    {
+      result = prefetcher->get(stream_position++);
+      if(result.getData() != nullptr)
+        break;
+    }
+  }
+  else if(!images.empty())
+  {
+    result = images[currentImageIndex];
+    currentImageIndex = static_cast<unsigned int>((currentImageIndex + 1) % images.size());
+  }
+
+  if(result.getData() == nullptr)
   {
     fprintf (stderr, "CaptureFromFile Error, no images available");
     is_capturing=false;
@@ -259,9 +416,6 @@ RawImage CaptureFromFile::getFrame()
     result.setHeight(480);
     result.setTime(0.0);
   } else {
-    result = images[currentImageIndex];
-    currentImageIndex = static_cast<unsigned int>((currentImageIndex + 1) % images.size());
-
     timeval tv{};
     gettimeofday(&tv, nullptr);
     result.setTime((double) tv.tv_sec + tv.tv_usec*(1.0E-6));
@@ -28,10 +28,52 @@
 #include <string>
 #include <list>
 #include <algorithm>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "VarTypes.h"
 
   #include <QMutex>
 
+/*!
+  \class   ImagePrefetcher
+  \brief   Loads image files on a small pool of background threads
+
+  Frames are requested by a running sequence number, which wraps around the
+  file list. Only a bounded window of frames ahead of the last request is
+  kept in memory, so memory use does not depend on the number of files.
+  Frames that failed to load are returned as empty images.
+*/
+class ImagePrefetcher
+{
+  protected:
+  std::vector<std::string> files;
+  int raw_width;
+  int raw_height;
+  unsigned long window;
+
+  std::mutex mutex;
+  std::condition_variable work_cond;
+  std::condition_variable ready_cond;
+  std::deque<unsigned long> todo;
+  std::map<unsigned long, RawImage> ready;
+  unsigned long scheduled;
+  bool stop;
+  std::vector<std::thread> workers;
+
+  void work();
+
+  public:
+  ImagePrefetcher(const std::vector<std::string> & _files, int _raw_width, int _raw_height,
+                  int _window, int threads);
+  ~ImagePrefetcher();
+
+  /// blocks until frame \p seq is loaded and returns it
+  RawImage get(unsigned long seq);
+  unsigned long size() const { return files.size(); }
+};
 
   #include <QMutex>
   //if using QT, inherit QObject as a base
@@ -52,6 +94,11 @@ protected:
   VarInt * v_raw_width;
   VarInt * v_raw_height;
 
+  //streaming variables:
+  VarBool * v_streaming;
+  VarInt * v_prefetch_frames;
+  VarInt * v_prefetch_threads;
+
   //capture variables:
   VarString * v_cap_dir;
   VarList * capture_settings;
@@ -60,12 +107,18 @@ protected:
   std::list<std::string> imgs_to_load;
   std::vector<RawImage> images;
   unsigned int currentImageIndex;
+  ImagePrefetcher * prefetcher;
+  unsigned long stream_position;
   
+  bool listImageFiles();
   bool isImageFileName(const std::string& fileName);
-  std::string getFileExtension(const std::string &fileName);
   std::vector<std::string> validImageFileEndings;
   
 public:
+  static std::string getFileExtension(const std::string &fileName);
+  static bool loadImageFile(const std::string & fileName, int raw_width, int raw_height,
+                            bool map_raw, RawImage & img);
+
   CaptureFromFile(VarList * _settings, int default_camera_id, QObject * parent=0);
   void mvc_connect(VarList * group);
   ~CaptureFromFile();
@@ -80,6 +133,7 @@ public:
   void cleanup();
 
   virtual bool copyAndConvertFrame(const RawImage & src, RawImage & target);
+  virtual bool lendFrame(const RawImage & src, RawImage & target);
   virtual string getCaptureMethodName() const;
 };
 
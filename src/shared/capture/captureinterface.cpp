@@ -51,3 +51,7 @@ bool CaptureInterface::copyAndConvertFrame(const RawImage & src, RawImage & targ
   memcpy(target.getData(),src.getData(),src.getNumBytes());
   return true;
 }
+
+bool CaptureInterface::lendFrame(const RawImage & src, RawImage & target) {
+  return false;
+}
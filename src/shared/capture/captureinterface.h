@@ -102,6 +102,20 @@ public:
     /// already allocated, and then memcpy the data as-is.
     virtual bool     copyAndConvertFrame(const RawImage & src, RawImage & target);
 
+    /// This is the zero-copy alternative to copyAndConvertFrame().
+    /// If the frame returned by getFrame() already has the desired output
+    /// format, a capture method can lend its own buffer to \p target
+    /// (see RawImage::lend()) instead of copying it.
+    /// The buffer must stay valid until the last RawImage holding it lets
+    /// go of the lease, which may be long after releaseFrame() or even
+    /// stopCapture() were called. The lease is the place to return the
+    /// buffer to the driver.
+    ///
+    /// Returns false if the frame cannot be lent, in which case the
+    /// caller falls back to copyAndConvertFrame().
+    /// The default implementation never lends.
+    virtual bool     lendFrame(const RawImage & src, RawImage & target);
+
     /// Return a string describing your capture method
     /// e.g. DC1394B, or GigEVision, or V4LCapture, or USBCam,...
     virtual string   getCaptureMethodName() const = 0;
@@ -0,0 +1,487 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    synthetic_scene.cpp
+  \brief   C++ Implementation: SyntheticScene
+*/
+//========================================================================
+
+#include "synthetic_scene.h"
+#include <math.h>
+#include <algorithm>
+#include <QReadLocker>
+
+static const rgb scene_field_color = rgb(  0,128,  0);
+static const rgb scene_surrounding_color = rgb( 48, 48, 48);
+static const rgb scene_robot_color = rgb( 16, 16, 16);
+
+//color classes used by the team pattern images:
+static inline bool isPatternCenter(const rgb & c) {
+  return c.b >= 128 && c.r < 64 && c.g < 64;
+}
+
+static inline bool isPatternHeightIndicator(const rgb & c) {
+  return c.r >= 128 && c.g >= 128 && c.b < 64;
+}
+
+SyntheticScene::SyntheticScene(VarList * parent)
+{
+  camera=0;
+  field=0;
+  pattern_rows=0;
+  pattern_cols=0;
+  needs_reset=true;
+
+  parent->addChild(settings = new VarList("Scene Settings"));
+  settings->addChild(v_enabled = new VarBool("Render Scene", false));
+  settings->addChild(v_pattern_file = new VarString("Marker Image File", "patterns/teams/standard2010_16.png"));
+  settings->addChild(v_pattern_rows = new VarInt("Marker Image Rows", 4, 1, 16));
+  settings->addChild(v_pattern_cols = new VarInt("Marker Image Cols", 4, 1, 16));
+  settings->addChild(v_pattern_scale = new VarDouble("Marker Image Scale (mm/pixel)", 1.0, 0.01));
+  settings->addChild(v_robots_per_team = new VarInt("Robots per Team", 8, 0, 16));
+  settings->addChild(v_balls = new VarInt("Balls", 1, 0, 100));
+  settings->addChild(v_robot_speed = new VarDouble("Robot Speed (mm/s)", 1000.0, 0.0));
+  settings->addChild(v_robot_turn_rate = new VarDouble("Robot Turn Rate (rad/s)", 2.0, 0.0));
+  settings->addChild(v_robot_radius = new VarDouble("Robot Radius (mm)", 90.0, 1.0));
+  settings->addChild(v_robot_height = new VarDouble("Robot Height (mm)", 140.0, 0.0));
+  settings->addChild(v_ball_speed = new VarDouble("Ball Speed (mm/s)", 3000.0, 0.0));
+  settings->addChild(v_ball_radius = new VarDouble("Ball Radius (mm)", 21.5, 1.0));
+  settings->addChild(v_seed = new VarInt("Random Seed", 42, 0));
+}
+
+SyntheticScene::~SyntheticScene()
+{
+}
+
+void SyntheticScene::setContext(const CameraParameters * _camera, const RoboCupField * _field)
+{
+  camera=_camera;
+  field=_field;
+  background_signature.clear();
+  needs_reset=true;
+}
+
+bool SyntheticScene::hasContext() const
+{
+  return camera!=0 && field!=0;
+}
+
+bool SyntheticScene::isEnabled() const
+{
+  return v_enabled->getBool();
+}
+
+bool SyntheticScene::loadPatterns()
+{
+  std::string file=v_pattern_file->getString();
+  int rows=v_pattern_rows->getInt();
+  int cols=v_pattern_cols->getInt();
+  if (file==pattern_file && rows==pattern_rows && cols==pattern_cols) {
+    return pattern_centers.empty()==false;
+  }
+  pattern_file=file;
+  pattern_rows=rows;
+  pattern_cols=cols;
+  pattern_centers.clear();
+
+  if (pattern_image.load(file)==false) {
+    fprintf(stderr,"SyntheticScene: unable to load marker image file '%s'\n",file.c_str());
+    return false;
+  }
+  int cell_w=pattern_image.getWidth() / cols;
+  int cell_h=pattern_image.getHeight() / rows;
+  if (cell_w==0 || cell_h==0) {
+    fprintf(stderr,"SyntheticScene: marker image '%s' is too small for %dx%d patterns\n",file.c_str(),rows,cols);
+    return false;
+  }
+
+  //locate the center dot of every pattern cell:
+  for (int idx=0;idx<rows*cols;idx++) {
+    int x0=(idx%cols)*cell_w;
+    int y0=(idx/cols)*cell_h;
+    double sum_x=0.0;
+    double sum_y=0.0;
+    int n=0;
+    for (int y=y0;y<y0+cell_h;y++) {
+      for (int x=x0;x<x0+cell_w;x++) {
+        if (isPatternCenter(pattern_image.getPixel(x,y))) {
+          sum_x+=x;
+          sum_y+=y;
+          n++;
+        }
+      }
+    }
+    if (n > 0) {
+      pattern_centers.push_back(GVector::vector2d<double>(sum_x/n,sum_y/n));
+    } else {
+      pattern_centers.push_back(GVector::vector2d<double>(x0+cell_w*0.5,y0+cell_h*0.5));
+    }
+  }
+  return true;
+}
+
+void SyntheticScene::randomizeMotion(double & vx, double & vy, double speed)
+{
+  double dir=rng.real32()*2.0*M_PI;
+  vx=cos(dir)*speed;
+  vy=sin(dir)*speed;
+}
+
+void SyntheticScene::reset()
+{
+  if (hasContext()==false) {
+    needs_reset=true;
+    return;
+  }
+  needs_reset=false;
+  rng.seed((uint32_t)v_seed->getInt());
+  loadPatterns();
+
+  double half_length=field->field_length->getDouble()*0.5;
+  double half_width=field->field_width->getDouble()*0.5;
+  double robot_radius=v_robot_radius->getDouble();
+  double ball_radius=v_ball_radius->getDouble();
+  int n_robots=v_robots_per_team->getInt();
+  if (pattern_centers.empty()==false) {
+    n_robots=std::min(n_robots,(int)pattern_centers.size());
+  }
+
+  GroundTruth state;
+  for (int team=TeamBlue;team<=TeamYellow;team++) {
+    for (int id=0;id<n_robots;id++) {
+      RobotState robot;
+      robot.team=team;
+      robot.id=id;
+      robot.x=rng.sreal32()*(half_length-robot_radius);
+      robot.y=rng.sreal32()*(half_width-robot_radius);
+      robot.angle=rng.sreal32()*M_PI;
+      randomizeMotion(robot.vx,robot.vy,v_robot_speed->getDouble());
+      robot.omega=rng.sreal32()*v_robot_turn_rate->getDouble();
+      state.robots.push_back(robot);
+    }
+  }
+  for (int i=0;i<v_balls->getInt();i++) {
+    BallState ball;
+    ball.x=rng.sreal32()*(half_length-ball_radius);
+    ball.y=rng.sreal32()*(half_width-ball_radius);
+    randomizeMotion(ball.vx,ball.vy,v_ball_speed->getDouble());
+    state.balls.push_back(ball);
+  }
+
+  truth_mutex.lock();
+  truth=state;
+  truth_mutex.unlock();
+}
+
+//moves a point along its velocity, reflecting it at the given bounds
+static void moveAndBounce(double & p, double & v, double dt, double bound)
+{
+  p+=v*dt;
+  if (bound <= 0.0) {
+    p=0.0;
+  } else if (p > bound) {
+    p=2.0*bound-p;
+    v=-v;
+  } else if (p < -bound) {
+    p=-2.0*bound-p;
+    v=-v;
+  }
+}
+
+void SyntheticScene::update(double time, double dt)
+{
+  if (hasContext()==false) return;
+  if (needs_reset) reset();
+
+  double half_length=field->field_length->getDouble()*0.5;
+  double half_width=field->field_width->getDouble()*0.5;
+  double robot_radius=v_robot_radius->getDouble();
+  double ball_radius=v_ball_radius->getDouble();
+
+  truth_mutex.lock();
+  for (unsigned int i=0;i<truth.robots.size();i++) {
+    RobotState & robot=truth.robots[i];
+    moveAndBounce(robot.x,robot.vx,dt,half_length-robot_radius);
+    moveAndBounce(robot.y,robot.vy,dt,half_width-robot_radius);
+    robot.angle=angle_mod(robot.angle+robot.omega*dt);
+  }
+  for (unsigned int i=0;i<truth.balls.size();i++) {
+    BallState & ball=truth.balls[i];
+    moveAndBounce(ball.x,ball.vx,dt,half_length-ball_radius);
+    moveAndBounce(ball.y,ball.vy,dt,half_width-ball_radius);
+  }
+  truth.frame++;
+  truth.time=time;
+  truth_mutex.unlock();
+}
+
+SyntheticScene::GroundTruth SyntheticScene::getGroundTruth()
+{
+  truth_mutex.lock();
+  GroundTruth res=truth;
+  truth_mutex.unlock();
+  return res;
+}
+
+void SyntheticScene::computeBackgroundSignature(int width, int height, std::vector<double> & signature) const
+{
+  signature.clear();
+  signature.push_back(width);
+  signature.push_back(height);
+  signature.push_back(camera->focal_length->getDouble());
+  signature.push_back(camera->principal_point_x->getDouble());
+  signature.push_back(camera->principal_point_y->getDouble());
+  signature.push_back(camera->distortion->getDouble());
+  signature.push_back(camera->q0->getDouble());
+  signature.push_back(camera->q1->getDouble());
+  signature.push_back(camera->q2->getDouble());
+  signature.push_back(camera->q3->getDouble());
+  signature.push_back(camera->tx->getDouble());
+  signature.push_back(camera->ty->getDouble());
+  signature.push_back(camera->tz->getDouble());
+  signature.push_back(field->field_length->getDouble());
+  signature.push_back(field->field_width->getDouble());
+  signature.push_back(field->boundary_width->getDouble());
+
+  QReadLocker locker(&field->field_markings_mutex);
+  for (unsigned int i=0;i<field->field_lines.size();i++) {
+    const FieldLine * line=field->field_lines[i];
+    signature.push_back(line->p1_x->getDouble());
+    signature.push_back(line->p1_y->getDouble());
+    signature.push_back(line->p2_x->getDouble());
+    signature.push_back(line->p2_y->getDouble());
+    signature.push_back(line->thickness->getDouble());
+  }
+  for (unsigned int i=0;i<field->field_arcs.size();i++) {
+    const FieldCircularArc * arc=field->field_arcs[i];
+    signature.push_back(arc->center_x->getDouble());
+    signature.push_back(arc->center_y->getDouble());
+    signature.push_back(arc->radius->getDouble());
+    signature.push_back(arc->a1->getDouble());
+    signature.push_back(arc->a2->getDouble());
+    signature.push_back(arc->thickness->getDouble());
+  }
+}
+
+void SyntheticScene::renderBackground(int width, int height)
+{
+  class Segment {
+  public:
+    double x1,y1,x2,y2,half_thickness;
+  };
+  class Arc {
+  public:
+    double x,y,radius,a1,a2,half_thickness;
+  };
+  std::vector<Segment> segments;
+  std::vector<Arc> arcs;
+  {
+    QReadLocker locker(&field->field_markings_mutex);
+    for (unsigned int i=0;i<field->field_lines.size();i++) {
+      const FieldLine * line=field->field_lines[i];
+      Segment s;
+      s.x1=line->p1_x->getDouble();
+      s.y1=line->p1_y->getDouble();
+      s.x2=line->p2_x->getDouble();
+      s.y2=line->p2_y->getDouble();
+      s.half_thickness=line->thickness->getDouble()*0.5;
+      segments.push_back(s);
+    }
+    for (unsigned int i=0;i<field->field_arcs.size();i++) {
+      const FieldCircularArc * arc=field->field_arcs[i];
+      Arc a;
+      a.x=arc->center_x->getDouble();
+      a.y=arc->center_y->getDouble();
+      a.radius=arc->radius->getDouble();
+      a.a1=arc->a1->getDouble();
+      a.a2=arc->a2->getDouble();
+      a.half_thickness=arc->thickness->getDouble()*0.5;
+      arcs.push_back(a);
+    }
+  }
+  double outer_x=field->field_length->getDouble()*0.5+field->boundary_width->getDouble();
+  double outer_y=field->field_width->getDouble()*0.5+field->boundary_width->getDouble();
+
+  background.allocate(width,height);
+  GVector::vector3d<double> p_f;
+  for (int y=0;y<height;y++) {
+    rgb * row=background.getPixelPointer(0,y);
+    for (int x=0;x<width;x++) {
+      camera->image2field(p_f,GVector::vector2d<double>(x,y),0.0);
+      if (fabs(p_f.x) > outer_x || fabs(p_f.y) > outer_y) {
+        row[x]=scene_surrounding_color;
+        continue;
+      }
+      rgb c=scene_field_color;
+      for (unsigned int i=0;i<segments.size();i++) {
+        const Segment & s=segments[i];
+        double dx=s.x2-s.x1;
+        double dy=s.y2-s.y1;
+        double len_sq=dx*dx+dy*dy;
+        double t=(len_sq > 0.0) ? ((p_f.x-s.x1)*dx+(p_f.y-s.y1)*dy)/len_sq : 0.0;
+        t=std::max(0.0,std::min(1.0,t));
+        double ex=p_f.x-(s.x1+t*dx);
+        double ey=p_f.y-(s.y1+t*dy);
+        if (ex*ex+ey*ey <= s.half_thickness*s.half_thickness) {
+          c=RGB::White;
+          break;
+        }
+      }
+      for (unsigned int i=0;i<arcs.size() && (c==RGB::White)==false;i++) {
+        const Arc & a=arcs[i];
+        double dx=p_f.x-a.x;
+        double dy=p_f.y-a.y;
+        if (fabs(sqrt(dx*dx+dy*dy)-a.radius) > a.half_thickness) continue;
+        double angle=atan2(dy,dx);
+        while (angle < a.a1) angle+=2.0*M_PI;
+        if (angle <= a.a2) c=RGB::White;
+      }
+      row[x]=c;
+    }
+  }
+}
+
+bool SyntheticScene::projectFootprint(double x, double y, double radius, double z, int width, int height,
+                                      int & x_min, int & y_min, int & x_max, int & y_max) const
+{
+  double min_x=width;
+  double min_y=height;
+  double max_x=-1.0;
+  double max_y=-1.0;
+  GVector::vector2d<double> p_i;
+  const int n=16;
+  for (int i=0;i<n;i++) {
+    double a=(2.0*M_PI*i)/n;
+    camera->field2image(GVector::vector3d<double>(x+cos(a)*radius,y+sin(a)*radius,z),p_i);
+    min_x=std::min(min_x,p_i.x);
+    min_y=std::min(min_y,p_i.y);
+    max_x=std::max(max_x,p_i.x);
+    max_y=std::max(max_y,p_i.y);
+  }
+  //skip objects outside of the view, or projected degenerately (e.g. behind the camera):
+  if (max_x < 0.0 || max_y < 0.0 || min_x >= width || min_y >= height) return false;
+  if ((max_x-min_x) > width*0.5 || (max_y-min_y) > height*0.5) return false;
+  x_min=std::max(0,(int)floor(min_x)-1);
+  y_min=std::max(0,(int)floor(min_y)-1);
+  x_max=std::min(width-1,(int)ceil(max_x)+1);
+  y_max=std::min(height-1,(int)ceil(max_y)+1);
+  return true;
+}
+
+void SyntheticScene::renderRobot(rgbImage & img, const RobotState & robot) const
+{
+  double radius=v_robot_radius->getDouble();
+  double z=v_robot_height->getDouble();
+  int x_min,y_min,x_max,y_max;
+  if (projectFootprint(robot.x,robot.y,radius,z,img.getWidth(),img.getHeight(),x_min,y_min,x_max,y_max)==false) {
+    return;
+  }
+
+  bool have_pattern=robot.id < (int)pattern_centers.size();
+  int cell_x0=0;
+  int cell_y0=0;
+  int cell_w=0;
+  int cell_h=0;
+  GVector::vector2d<double> center;
+  if (have_pattern) {
+    cell_w=pattern_image.getWidth() / pattern_cols;
+    cell_h=pattern_image.getHeight() / pattern_rows;
+    cell_x0=(robot.id % pattern_cols)*cell_w;
+    cell_y0=(robot.id / pattern_cols)*cell_h;
+    center=pattern_centers[robot.id];
+  }
+  double scale=v_pattern_scale->getDouble();
+  rgb team_color=(robot.team==TeamBlue) ? RGB::Blue : RGB::Yellow;
+  double cos_a=cos(robot.angle);
+  double sin_a=sin(robot.angle);
+
+  GVector::vector3d<double> p_f;
+  for (int y=y_min;y<=y_max;y++) {
+    for (int x=x_min;x<=x_max;x++) {
+      camera->image2field(p_f,GVector::vector2d<double>(x,y),z);
+      double dx=p_f.x-robot.x;
+      double dy=p_f.y-robot.y;
+      if (dx*dx+dy*dy > radius*radius) continue;
+      //robot-local coordinates, x pointing forward:
+      double lx= cos_a*dx+sin_a*dy;
+      double ly=-sin_a*dx+cos_a*dy;
+      rgb c=scene_robot_color;
+      if (have_pattern) {
+        //inverse of the image to robot mapping in MultiPatternModel::loadSinglePatternImage
+        int px=(int)floor(center.x-ly/scale+0.5);
+        int py=(int)floor(center.y-lx/scale+0.5);
+        if (px >= cell_x0 && px < cell_x0+cell_w && py >= cell_y0 && py < cell_y0+cell_h) {
+          rgb p=pattern_image.getPixel(px,py);
+          if (isPatternCenter(p)) {
+            c=team_color;
+          } else if (isPatternHeightIndicator(p)==false && (p==RGB::Black)==false) {
+            c=p;
+          }
+        }
+      } else if (lx*lx+ly*ly <= 25.0*25.0) {
+        c=team_color;
+      }
+      img.setPixel(x,y,c);
+    }
+  }
+}
+
+void SyntheticScene::renderBall(rgbImage & img, const BallState & ball) const
+{
+  double radius=v_ball_radius->getDouble();
+  int x_min,y_min,x_max,y_max;
+  if (projectFootprint(ball.x,ball.y,radius,radius,img.getWidth(),img.getHeight(),x_min,y_min,x_max,y_max)==false) {
+    return;
+  }
+  GVector::vector3d<double> p_f;
+  for (int y=y_min;y<=y_max;y++) {
+    for (int x=x_min;x<=x_max;x++) {
+      camera->image2field(p_f,GVector::vector2d<double>(x,y),radius);
+      double dx=p_f.x-ball.x;
+      double dy=p_f.y-ball.y;
+      if (dx*dx+dy*dy <= radius*radius) {
+        img.setPixel(x,y,RGB::Orange);
+      }
+    }
+  }
+}
+
+void SyntheticScene::render(rgbImage & img)
+{
+  if (hasContext()==false) {
+    img.fillBlack();
+    return;
+  }
+  if (needs_reset) reset();
+  loadPatterns();
+
+  int width=img.getWidth();
+  int height=img.getHeight();
+  std::vector<double> signature;
+  computeBackgroundSignature(width,height,signature);
+  if (signature!=background_signature) {
+    renderBackground(width,height);
+    background_signature=signature;
+  }
+  memcpy(img.getData(),background.getData(),background.getNumBytes());
+
+  GroundTruth state=getGroundTruth();
+  for (unsigned int i=0;i<state.balls.size();i++) {
+    renderBall(img,state.balls[i]);
+  }
+  for (unsigned int i=0;i<state.robots.size();i++) {
+    renderRobot(img,state.robots[i]);
+  }
+}
@@ -0,0 +1,151 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    synthetic_scene.h
+  \brief   C++ Interface: SyntheticScene
+*/
+//========================================================================
+
+#ifndef SYNTHETIC_SCENE_H
+#define SYNTHETIC_SCENE_H
+
+#include <string>
+#include <vector>
+#include <QMutex>
+#include "VarTypes.h"
+#include "image.h"
+#include "random.h"
+#include "camera_calibration.h"
+#include "field.h"
+
+/*!
+  \class   SyntheticScene
+  \brief   Renders a simulated SSL scene (field, robots and balls) through a camera model
+
+  Robots are drawn with the marker layouts of the team pattern image that
+  is also used by the team detector, so the scene can be processed by the
+  regular vision stack. All objects are placed and moved in field
+  coordinates and projected through the current CameraParameters, which
+  makes the ground truth of every rendered frame known exactly.
+
+  Motion is driven by the frame count, not by wall time, and all random
+  choices come from a seeded generator: the same settings always produce
+  the same sequence of frames.
+*/
+class SyntheticScene {
+public:
+  enum Team {
+    TeamBlue=0,
+    TeamYellow=1
+  };
+
+  class RobotState {
+  public:
+    int team;
+    int id;
+    double x;
+    double y;
+    double angle;
+    double vx;
+    double vy;
+    double omega;
+  };
+
+  class BallState {
+  public:
+    double x;
+    double y;
+    double vx;
+    double vy;
+  };
+
+  class GroundTruth {
+  public:
+    long frame;
+    double time;
+    std::vector<RobotState> robots;
+    std::vector<BallState> balls;
+    GroundTruth() {
+      frame=0;
+      time=0.0;
+    }
+  };
+
+protected:
+  VarList * settings;
+  VarBool * v_enabled;
+  VarString * v_pattern_file;
+  VarInt * v_pattern_rows;
+  VarInt * v_pattern_cols;
+  VarDouble * v_pattern_scale;
+  VarInt * v_robots_per_team;
+  VarInt * v_balls;
+  VarDouble * v_robot_speed;
+  VarDouble * v_robot_turn_rate;
+  VarDouble * v_robot_radius;
+  VarDouble * v_robot_height;
+  VarDouble * v_ball_speed;
+  VarDouble * v_ball_radius;
+  VarInt * v_seed;
+
+  const CameraParameters * camera;
+  const RoboCupField * field;
+
+  //team pattern image and the blue center dot of each of its cells:
+  rgbImage pattern_image;
+  std::string pattern_file;
+  int pattern_rows;
+  int pattern_cols;
+  std::vector<GVector::vector2d<double> > pattern_centers;
+
+  //field background, re-rendered whenever calibration or geometry changes:
+  rgbImage background;
+  std::vector<double> background_signature;
+
+  Random rng;
+  bool needs_reset;
+  QMutex truth_mutex;
+  GroundTruth truth;
+
+  bool loadPatterns();
+  void computeBackgroundSignature(int width, int height, std::vector<double> & signature) const;
+  void renderBackground(int width, int height);
+  void renderRobot(rgbImage & img, const RobotState & robot) const;
+  void renderBall(rgbImage & img, const BallState & ball) const;
+  bool projectFootprint(double x, double y, double radius, double z, int width, int height,
+                        int & x_min, int & y_min, int & x_max, int & y_max) const;
+  void randomizeMotion(double & vx, double & vy, double speed);
+
+public:
+  SyntheticScene(VarList * parent);
+  ~SyntheticScene();
+
+  /// sets the camera model and field geometry used for rendering
+  void setContext(const CameraParameters * _camera, const RoboCupField * _field);
+  bool hasContext() const;
+  bool isEnabled() const;
+
+  /// places all robots and balls again, starting from the configured seed
+  void reset();
+  /// advances the scene by \p dt seconds and stamps it with \p time
+  void update(double time, double dt);
+  /// draws the current scene into \p img
+  void render(rgbImage & img);
+
+  /// returns a copy of the current object states in field coordinates
+  GroundTruth getGroundTruth();
+};
+
+#endif
@@ -109,6 +109,21 @@ void PatternProcessing::sortMarkersByAngle(Marker *marker,int num) {
   std::sort(&marker[0],&marker[num],LessMarkerAngle());
 }
 
+//the marker colors in ascending order, packed like a pattern code.
+//Only meaningful for up to MaxCodedMarkers markers.
+static pattern_t sortedColors(const Marker *markers,int num_markers) {
+  uint8_t colors[MaxMarkers];
+  for(int i=0; i<num_markers; i++){
+    colors[i] = markers[i].id.v;
+  }
+  std::sort(&colors[0],&colors[num_markers]);
+  pattern_t code = 0x00;
+  for(int i=0; i<num_markers; i++){
+    code = (code << 8) | colors[i];
+  }
+  return(code);
+}
+
 MultiPatternModel::MultiPatternModel() {
   patterns=0;
   num_patterns=0;
@@ -191,6 +206,38 @@ void MultiPatternModel::clearPatternModels() {
     patterns[i].reset();
   }
   marker_max_dist=0.0;
+  compilePatterns();
+}
+
+void MultiPatternModel::compilePatterns() {
+  table_entry.assign(num_patterns,-1);
+  table_pattern_idx.clear();
+  table_num_markers.clear();
+  table_code.clear();
+  table_colors.clear();
+  table_marker_begin.clear();
+  table_area.clear();
+  table_dist.clear();
+  table_next_dist.clear();
+  table_next_angle_dist.clear();
+
+  for (int i = 0; i < num_patterns; i++) {
+    const Pattern &p = patterns[i];
+    //findPattern() never matches more than MaxMarkers markers
+    if (!p.enabled || p.num_markers == 0 || p.num_markers > MaxMarkers) continue;
+    table_entry[i] = table_pattern_idx.size();
+    table_pattern_idx.push_back(i);
+    table_num_markers.push_back(p.num_markers);
+    table_code.push_back(p.pattern);
+    table_colors.push_back(sortedColors(p.markers,p.num_markers));
+    table_marker_begin.push_back(table_area.size());
+    for (int j = 0; j < p.num_markers; j++) {
+      table_area.push_back(p.markers[j].area);
+      table_dist.push_back(p.markers[j].dist);
+      table_next_dist.push_back(p.markers[j].next_dist);
+      table_next_angle_dist.push_back(p.markers[j].next_angle_dist);
+    }
+  }
 }
 
 
@@ -316,6 +363,7 @@ bool MultiPatternModel::loadSinglePatternImage(const yuvImage & image, YUVLUT *
   p.pattern = pattern;
   p.height = height;
   p.robot_id = idx;
+  compilePatterns();
 
   //TODO:  a nice feature would be to automatically calculate histogram
   //       percentages here.
@@ -324,44 +372,31 @@ bool MultiPatternModel::loadSinglePatternImage(const yuvImage & image, YUVLUT *
 }
 
 
-double MultiPatternModel::calcFitError(const Marker *model,
-                                      const Marker *markers,
-                                      int num_markers,int ofs, const PatternFitParameters & fit_params) const
+double MultiPatternModel::calcFitError(int k,
+                                      const float *area,
+                                      const float *dist,
+                                      const float *next_dist,
+                                      const float *next_angle_dist, const PatternFitParameters & fit_params) const
 {
+  int num_markers = table_num_markers[k];
+  int begin = table_marker_begin[k];
+  const float *model_area = &table_area[begin];
+  const float *model_dist = &table_dist[begin];
+  const float *model_next_dist = &table_next_dist[begin];
+  const float *model_next_angle_dist = &table_next_angle_dist[begin];
+
+  //NORMALIZED FIT, computed per marker in one pass that the compiler can vectorize:
+  float err[MaxMarkers];
+  for(int i=0; i<num_markers; i++){
+    err[i] =
+      (fit_params.fit_area_weight      * sq( (model_area[i]      - area[i]) / model_area[i]) +
+      fit_params.fit_cen_dist_weight  * sq(  (model_dist[i]      - dist[i]) / model_dist[i]) +
+      fit_params.fit_next_dist_weight * sq(  (model_next_dist[i] - next_dist[i]) / model_next_dist[i]) +
+      fit_params.fit_next_angle_dist_weight * sq(  (model_next_angle_dist[i] - next_angle_dist[i]) /  model_next_angle_dist[i]));
+  }
   double sse = 0.0;
   for(int i=0; i<num_markers; i++){
-    int j = (i + ofs) % num_markers;
-    
-    /* OLD FIT:
-    sse +=
-      
-      (fit_params.fit_area_weight      * sq( model[i].area      - markers[j].area) +
-      fit_params.fit_cen_dist_weight  * sq(  model[i].dist      - markers[j].dist) +
-      fit_params.fit_next_dist_weight * sq(  model[i].next_dist - markers[j].next_dist) +
-      fit_params.fit_next_angle_dist_weight * sq(  model[i].next_angle_dist - markers[j].next_angle_dist));
-      printf("----------\narea: %8.2f\ncent: %8.2f\ndist: %8.2f\nangd: %8.2f\nTOTAL %8.2f\n",sq( model[i].area      - markers[j].area),sq(  model[i].dist      - markers[j].dist),sq(  model[i].next_dist - markers[j].next_dist),sq(  model[i].next_angle_dist - markers[j].next_angle_dist),sse);
-      printf("areas: %f vs. %f\n",model[i].area,markers[j].area);
-      printf("diff: %f\n", model[i].area      - markers[j].area\n);
-      printf("diff sq: %f\n",sq( model[i].area      - markers[j].area));*/
-      
-     //NORMALIZED FIT:
-    sse +=
-      
-      (fit_params.fit_area_weight      * sq( (model[i].area      - markers[j].area) / model[i].area) +
-      fit_params.fit_cen_dist_weight  * sq(  (model[i].dist      - markers[j].dist) / model[i].dist) +
-      fit_params.fit_next_dist_weight * sq(  (model[i].next_dist - markers[j].next_dist) / model[i].next_dist) +
-      fit_params.fit_next_angle_dist_weight * sq(  (model[i].next_angle_dist - markers[j].next_angle_dist) /  model[i].next_angle_dist));
-      /*printf("----------\narea: %8.5f\ncent: %8.5f\ndist: %8.5f\nangd: %8.5f\nTOTAL %8.5f\n",
-      sq((model[i].area      - markers[j].area) / model[i].area),
-      sq((model[i].dist      - markers[j].dist) / model[i].dist),
-       sq(  (model[i].next_dist - markers[j].next_dist) / model[i].next_dist),
-       sq(  (model[i].next_angle_dist - markers[j].next_angle_dist) /  model[i].next_angle_dist),sse);*/
-      //sq(  model[i].dist      - markers[j].dist),sq(  model[i].next_dist - markers[j].next_dist),sq(  model[i].next_angle_dist - markers[j].next_angle_dist),sse);
-      //printf("areas: %f vs. %f\n",model[i].area,markers[j].area);
-      //printf("diff: %f\n", model[i].area      - markers[j].area);
-      //printf("ang: %f  %f  dist: %f   sqdist: %f\n",model[i].next_angle_dist,markers[j].next_angle_dist,(model[i].next_angle_dist - markers[j].next_angle_dist),sq(  (model[i].next_angle_dist - markers[j].next_angle_dist) /  model[i].next_angle_dist));
-      //printf("diff sq: %f\n",sq( model[i].area      - markers[j].area));
-      
+    sse += err[i];
   }
   //normalize sse over number of markers:
   sse/=num_markers;
@@ -382,11 +417,52 @@ void MultiPatternModel::recheckColorsUsed() {
       }
     }
   }
+  compilePatterns();
+}
+
+bool MultiPatternModel::findPattern(PatternDetectionResult & result, Marker * markers,int num_markers, const PatternFitParameters & fit_params,const CameraParameters::Snapshot& calibration) const {
+  return searchPattern(result,0,table_pattern_idx.size(),markers,num_markers,fit_params,calibration);
 }
 
-bool MultiPatternModel::findPattern(PatternDetectionResult & result, Marker * markers,int num_markers, const PatternFitParameters & fit_params,const CameraParameters& camera_params) const {
+bool MultiPatternModel::checkPattern(PatternDetectionResult & result, int idx, Marker * markers,int num_markers, const PatternFitParameters & fit_params,const CameraParameters::Snapshot& calibration) const {
+  if(idx<0 || idx>=(int)table_entry.size() || table_entry[idx]<0){
+    result.reset();
+    return false;
+  }
+  return searchPattern(result,table_entry[idx],table_entry[idx]+1,markers,num_markers,fit_params,calibration);
+}
+
+bool MultiPatternModel::searchPattern(PatternDetectionResult & result, int k_begin, int k_end, Marker * markers,int num_markers, const PatternFitParameters & fit_params,const CameraParameters::Snapshot& calibration) const {
   if(markers==0 || num_markers<0) return(false);
 
+  //patterns are rearranged below within MaxMarkers markers:
+  if(num_markers > MaxMarkers) return(false);
+
+  //the colors of all offsets, for rejecting patterns without a matching offset
+  pattern_t colors = sortedColors(markers,num_markers);
+  bool check_colors = (num_markers <= MaxCodedMarkers);
+  int num_candidates = 0;
+  for(int k=k_begin; k<k_end; k++){
+    if(table_num_markers[k]==num_markers && (!check_colors || table_colors[k]==colors)) num_candidates++;
+  }
+  if(num_candidates == 0){
+    result.reset();
+    return false;
+  }
+
+  //marker properties, repeated once so that every offset is a contiguous range:
+  float area[2*MaxMarkers];
+  float dist[2*MaxMarkers];
+  float next_dist[2*MaxMarkers];
+  float next_angle_dist[2*MaxMarkers];
+  for(int i=0; i<2*num_markers; i++){
+    const Marker &m = markers[i % num_markers];
+    area[i] = m.area;
+    dist[i] = m.dist;
+    next_dist[i] = m.next_dist;
+    next_angle_dist[i] = m.next_angle_dist;
+  }
+
   int best_idx = -1;
   int best_ofs = 0;
   double best_sse = sq(fit_params.fit_max_error);
@@ -400,23 +476,14 @@ bool MultiPatternModel::findPattern(PatternDetectionResult & result, Marker * ma
     }
 
     // find covers with matching pattern code and number of markers
-    for(int i=0; i<num_patterns; i++){
-      if (patterns[i].enabled) {
-        const Pattern &p = patterns[i];
-        if(p.num_markers==num_markers && p.pattern==pattern){
-          // calculate fit error for matching pattern
-          double sse = calcFitError(p.markers,markers,num_markers,ofs,fit_params);
-//          printf("SSE: %f\n",sse);
-          /*if(unlikely(verbose > 1)){
-            float conf = SSEVsUniform(sse,fit_variance,fit_uniform);
-            printf("    0x%04X id=%X err=%6.3f conf=%0.6f\n",
-                  pattern,rc.robot_id,sqrt(sse),conf);
-          }*/
-          if(sse < best_sse){
-            best_idx = i;
-            best_ofs = ofs;
-            best_sse = sse;
-          }
+    for(int k=k_begin; k<k_end; k++){
+      if(table_num_markers[k]==num_markers && table_code[k]==pattern){
+        // calculate fit error for matching pattern
+        double sse = calcFitError(k,&area[ofs],&dist[ofs],&next_dist[ofs],&next_angle_dist[ofs],fit_params);
+        if(sse < best_sse){
+          best_idx = table_pattern_idx[k];
+          best_ofs = ofs;
+          best_sse = sse;
         }
       }
     }
@@ -429,7 +496,7 @@ bool MultiPatternModel::findPattern(PatternDetectionResult & result, Marker * ma
     for(int i=0; i<num_markers; i++){
       vector2d marker_img_center(markers[i].reg->cen_x,markers[i].reg->cen_y);
       vector3d marker_center3d;
-      camera_params.image2field(marker_center3d,marker_img_center,markers[i].height);
+      calibration.image2field(marker_center3d,marker_img_center,markers[i].height);
       markers[i].loc.set(marker_center3d.x,marker_center3d.y);
     }
 
@@ -37,6 +37,8 @@ namespace CMPattern {
 //formerly ModelMarker
 typedef uint64_t pattern_t;
 static const int MaxMarkers = 16;
+//the number of marker colors a pattern_t holds
+static const int MaxCodedMarkers = sizeof(pattern_t);
 
 
 class Marker {
@@ -177,10 +179,29 @@ protected:
   int       num_patterns;
   Pattern * patterns;
   ColorsUsed used;
+
+  //the enabled patterns, compiled by compilePatterns() for findPattern().
+  //The markers of entry k are [table_marker_begin[k],table_marker_begin[k]+table_num_markers[k])
+  //in the per marker arrays, in the order of the pattern code.
+  vector<int>       table_entry;  // per pattern, -1 if not in the table
+  vector<int>       table_pattern_idx;
+  vector<int>       table_num_markers;
+  vector<pattern_t> table_code;
+  vector<pattern_t> table_colors; // sorted marker colors, the same for every rotation
+  vector<int>       table_marker_begin;
+  vector<float>     table_area;
+  vector<float>     table_dist;
+  vector<float>     table_next_dist;
+  vector<float>     table_next_angle_dist;
 protected:
   void calcDerived();
   void allocate(int num_patterns);
-  double calcFitError(const Marker *model, const Marker *markers, int num_markers, int ofs, const PatternFitParameters & fit_params) const;
+  void compilePatterns();
+  //fit error of table entry k against markers that are given per property,
+  //already rotated by the offset to test
+  double calcFitError(int k, const float * area, const float * dist, const float * next_dist, const float * next_angle_dist, const PatternFitParameters & fit_params) const;
+  //finds the best fitting table entry in [k_begin,k_end), over all offsets of the markers
+  bool searchPattern(PatternDetectionResult & result, int k_begin, int k_end, Marker * markers,int num_markers, const PatternFitParameters & fit_params,const CameraParameters::Snapshot& calibration) const;
 public:
   MultiPatternModel();
   ~MultiPatternModel();
@@ -190,7 +211,9 @@ public:
   bool usesColor(raw8 color_id) const;
   bool loadSinglePatternImage(const yuvImage & image, YUVLUT * _lut,int idx, float default_object_height=0.0);
   bool loadMultiPatternImage(const yuvImage & image, YUVLUT * _lut, int rows=4, int cols=4, float default_object_height=0.0);
-  bool findPattern(PatternDetectionResult & result, Marker * markers,int num_markers, const PatternFitParameters & fit_params,const CameraParameters& camera_params) const;
+  bool findPattern(PatternDetectionResult & result, Marker * markers,int num_markers, const PatternFitParameters & fit_params,const CameraParameters::Snapshot& calibration) const;
+  //like findPattern(), but only tries the pattern idx
+  bool checkPattern(PatternDetectionResult & result, int idx, Marker * markers,int num_markers, const PatternFitParameters & fit_params,const CameraParameters::Snapshot& calibration) const;
   void recheckColorsUsed();//to be used if patterns have been enabled/disabled;
 };
 
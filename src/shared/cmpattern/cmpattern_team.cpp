@@ -107,6 +107,11 @@ RobotPattern::RobotPattern(VarList * team_root)
       _pattern_fitness_stddev = _pattern_fitness->findChildOrReplace(new VarDouble("Expected StdDev",0.5));
       _pattern_fitness_uniform = _pattern_fitness->findChildOrReplace(new VarDouble("Uniform",0.05));
 
+    _id_cache = _settings->findChildOrReplace(new VarList("ID Cache"));
+      _id_cache_enable = _id_cache->findChildOrReplace(new VarBool("Enable",false));
+      _id_cache_gating_radius = _id_cache->findChildOrReplace(new VarDouble("Gating Radius (mm)",50.0));
+      _id_cache_full_check_interval = _id_cache->findChildOrReplace(new VarInt("Full Check Interval (frames)",30));
+
   _notifier.addRecursive(_settings);
   connect(&_notifier,SIGNAL(changeOccured(VarType*)),this,SLOT(slotChangeOccured(VarType *)));
 }
@@ -116,5 +121,10 @@ RobotPattern::~RobotPattern()
 {
 }
 
+bool RobotPattern::usesHistogram() const
+{
+  return _histogram_enable->getBool() && _histogram_pixel_scan_radius->getInt() > 0;
+}
+
 
 }
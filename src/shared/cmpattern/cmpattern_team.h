@@ -115,11 +115,19 @@ protected:
       VarDouble * _pattern_fitness_stddev;
       VarDouble * _pattern_fitness_uniform;
 
+    VarList * _id_cache;
+      VarBool * _id_cache_enable;
+      VarDouble * _id_cache_gating_radius;
+      VarInt * _id_cache_full_check_interval;
+
 public:
     RobotPattern(VarList * team_root);
 
     ~RobotPattern();
 
+    /// whether detection runs the histogram check, which reads the color-thresholded image
+    bool usesHistogram() const;
+
 };
 
 }
@@ -20,6 +20,7 @@
 */
 //========================================================================
 #include "cmpattern_teamdetector.h"
+#include <algorithm>
 
 namespace CMPattern {
 
@@ -58,11 +59,14 @@ Team * TeamDetectorSettings::getTeam(int idx) const {
   return (team_vector[idx]);
 }
 
-TeamDetector::TeamDetector(LUT3D * lut3d, const CameraParameters& camera_params, const RoboCupField& field) : _camera_params(camera_params), _field(field) {
+TeamDetector::TeamDetector(LUT3D * lut3d, const CameraParameters& camera_params, const RoboCupField& field) : _camera_params(camera_params), _robot_height_table(camera_params), _field(field) {
   _robotPattern=0;
+  _team=0;
   _lut3d=lut3d;
 
   histogram=0;
+  _integral_histogram=0;
+  _histogram_check=false;
 
   color_id_cyan = _lut3d->getChannelID("Cyan");
   if (color_id_cyan == -1) printf("WARNING color label 'Cyan' not defined in LUT!!!\n");
@@ -91,6 +95,8 @@ TeamDetector::TeamDetector(LUT3D * lut3d, const CameraParameters& camera_params,
 void TeamDetector::init(RobotPattern * robotPattern, Team * team)
 {
   _robotPattern=robotPattern;
+  //cached patterns belong to the previous team:
+  if (team != _team) id_cache.clear();
   _team = team;
 
   if (histogram==0) histogram= new CMVision::Histogram(_lut3d->getChannelCount());
@@ -124,7 +130,7 @@ void TeamDetector::init(RobotPattern * robotPattern, Team * team)
   filter_others.setHeight(_robotPattern->_other_markers_min_height->getInt(),robotPattern->_other_markers_max_height->getInt());
   filter_others.setArea(_robotPattern->_other_markers_min_area->getInt(),robotPattern->_other_markers_max_area->getInt());
 
-  _histogram_enable=_robotPattern->_histogram_enable->getBool();
+  _histogram_enable=_robotPattern->usesHistogram();
   _histogram_pixel_scan_radius=_robotPattern->_histogram_pixel_scan_radius->getInt();
 
   _histogram_markeryness.set(_robotPattern->_histogram_min_markeryness->getDouble(),_robotPattern->_histogram_max_markeryness->getDouble());
@@ -141,6 +147,11 @@ void TeamDetector::init(RobotPattern * robotPattern, Team * team)
   _pattern_fit_params.fit_variance=sq(_robotPattern->_pattern_fitness_stddev->getDouble());
   _pattern_fit_params.fit_uniform=_robotPattern->_pattern_fitness_uniform->getDouble();
 
+  _id_cache_enable=_robotPattern->_id_cache_enable->getBool();
+  _id_cache_gating_radius=_robotPattern->_id_cache_gating_radius->getDouble();
+  _id_cache_full_check_interval=_robotPattern->_id_cache_full_check_interval->getInt();
+  if (!_id_cache_enable) id_cache.clear();
+
   //load team image:
 
 
@@ -178,14 +189,22 @@ TeamDetector::~TeamDetector()
   if (histogram !=0) delete histogram;
 }
 
-void TeamDetector::update(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots, int team_color_id, int max_robots, const Image<raw8> * image, CMVision::ColorRegionList * colorlist, CMVision::RegionTree & reg_tree) {
+void TeamDetector::update(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots, int team_color_id, int max_robots, int image_width, int image_height, const Image<raw8> * image, CMVision::ColorRegionList * colorlist, const CMVision::RegionTree & reg_tree, const CMVision::IntegralHistogram * integral_histogram) {
   color_id_team=team_color_id;
+  _integral_histogram=integral_histogram;
   _max_robots=max_robots;
+  //the image is empty if thresholding decided that no plugin reads it this frame,
+  //as it does when the histogram was enabled only after that decision:
+  _histogram_check=_histogram_enable && image->getNumPixels() > 0;
   robots->Clear();
+  _calibration=_camera_params.getSnapshot();
+  _robot_height_table.update(image_width,image_height,_robot_height);
 
   if (_unique_patterns) {
     findRobotsByModel(robots,team_color_id,image,colorlist,reg_tree);
   } else {
+    //cached patterns are of no use without pattern matching:
+    id_cache.clear();
     findRobotsByTeamMarkerOnly(robots,team_color_id,image,colorlist);
   }
 
@@ -202,17 +221,17 @@ void TeamDetector::findRobotsByTeamMarkerOnly(::google::protobuf::RepeatedPtrFie
   //TODO: change these to update on demand:
   //local variables
   const CMVision::Region * reg=0;
-  SSL_DetectionRobot * robot=0;
+  candidates.clear();
   while((reg = filter_team.getNext()) != 0) {
     vector2d reg_img_center(reg->cen_x,reg->cen_y);
     vector3d reg_center3d;
-    _camera_params.image2field(reg_center3d,reg_img_center,_robot_height);
+    _robot_height_table.image2field(reg_center3d,reg_img_center);
     vector2d reg_center(reg_center3d.x,reg_center3d.y);
 
     //TODO: add confidence masking:
     //float conf = det.mask.get(reg->cen_x,reg->cen_y);
     double conf=1.0;
-    if (field_filter.isInFieldOrPlayableBoundary(reg_center) &&  ((_histogram_enable==false) || checkHistogram(reg,image)==true)) {
+    if (field_filter.isInFieldOrPlayableBoundary(reg_center) &&  ((_histogram_check==false) || checkHistogram(reg,image)==true)) {
       double area = getRegionArea(reg,_robot_height);
       double area_err = fabs(area - _center_marker_area_mean);
 
@@ -225,39 +244,30 @@ void TeamDetector::findRobotsByTeamMarkerOnly(::google::protobuf::RepeatedPtrFie
       }
       if(det.debug) det.color(reg,rc,conf);*/
 
-      //allow twice as many robots for now...
-      //duplicate filtering will take care of the rest below:
-      robot=addRobot(robots,conf,_max_robots*2);
-
-      if (robot!=0) {
-        //setup robot:
-        robot->set_x(reg_center.x);
-        robot->set_y(reg_center.y);
-        robot->set_pixel_x(reg->cen_x);
-        robot->set_pixel_y(reg->cen_y);
-        robot->set_height(_robot_height);
-      }
+      Candidate & robot=addCandidate(conf);
+      robot.x=reg_center.x;
+      robot.y=reg_center.y;
+      robot.pixel_x=reg->cen_x;
+      robot.pixel_y=reg->cen_y;
+      robot.height=_robot_height;
     }
   }
 
+  //allow twice as many robots for now...
+  //duplicate filtering will take care of the rest below:
+  int size=rankCandidates(_max_robots*2);
+
   // remove duplicates ... keep the ones with higher confidence:
-  int size=robots->size();
   for(int i=0; i<size; i++){
     for(int j=i+1; j<size; j++){
-      if(sqdist(vector2d(robots->Get(i).x(),robots->Get(i).y()),vector2d(robots->Get(j).x(),robots->Get(j).y())) < sq(_center_marker_duplicate_distance)) {
-        robots->Mutable(i)->set_confidence(0.0);
+      if(sqdist(vector2d(candidates[i].x,candidates[i].y),vector2d(candidates[j].x,candidates[j].y)) < sq(_center_marker_duplicate_distance)) {
+        candidates[i].conf=0.0;
       }
     }
   }
 
-  //remove items with 0-confidence:
-  stripRobots(robots);
-
-  //remove extra items:
-  while(robots->size() > _max_robots) {
-    robots->RemoveLast();
-  }
-
+  //write all but the items with 0-confidence:
+  writeRobots(robots,size,_max_robots);
 }
 
 
@@ -271,8 +281,13 @@ double TeamDetector::getRegionArea(const CMVision::Region * reg, double z) const
   vector3d a,b;
   vector2d right(reg->x2+1,reg->y2+1);
   vector2d left(reg->x1,reg->y1);
-  _camera_params.image2field(a,right,z);
-  _camera_params.image2field(b,left,z);
+  if (z==_robot_height_table.getHeight()) {
+    _robot_height_table.image2field(a,right);
+    _robot_height_table.image2field(b,left);
+  } else {
+    _calibration->image2field(a,right,z);
+    _calibration->image2field(b,left,z);
+  }
   vector3d box = a-b;
 
   double box_area = fabs(box.x) * fabs(box.y);
@@ -285,16 +300,28 @@ double TeamDetector::getRegionArea(const CMVision::Region * reg, double z) const
 }
 
 
+bool TeamDetector::usesHistogramChannel(int color_id) const {
+  return color_id == color_id_pink || color_id == color_id_green || color_id == color_id_cyan ||
+         color_id == color_id_field_green || color_id == color_id_white || color_id == color_id_black ||
+         color_id == color_id_clear;
+}
+
 bool TeamDetector::checkHistogram(const CMVision::Region * reg, const Image<raw8> * image) {
 
-  if(_histogram_pixel_scan_radius == 0) return(true);
+  if(_histogram_pixel_scan_radius <= 0) return(true);
 
   histogram->clear();
 
   int ix = (int)(reg->cen_x);
   int iy = (int)(reg->cen_y);
-  int num = histogram->addBox(image,ix-_histogram_pixel_scan_radius,iy-_histogram_pixel_scan_radius,
+  int num;
+  if (_integral_histogram!=0) {
+    num = histogram->addBox(_integral_histogram,ix-_histogram_pixel_scan_radius,iy-_histogram_pixel_scan_radius,
               ix+_histogram_pixel_scan_radius,iy+_histogram_pixel_scan_radius);
+  } else {
+    num = histogram->addBox(image,ix-_histogram_pixel_scan_radius,iy-_histogram_pixel_scan_radius,
+              ix+_histogram_pixel_scan_radius,iy+_histogram_pixel_scan_radius);
+  }
 
   float inv_num = 1.0 / num;
 
@@ -354,52 +381,73 @@ bool TeamDetector::checkHistogram(const CMVision::Region * reg, const Image<raw8
 }
 
 
-SSL_DetectionRobot * TeamDetector::addRobot(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots, double conf, int max_robots) {
+TeamDetector::Candidate & TeamDetector::addCandidate(double conf) {
+  Candidate c;
+  c.conf=conf;
+  c.index=(int)candidates.size();
+  c.x=0.0;
+  c.y=0.0;
+  c.pixel_x=0.0;
+  c.pixel_y=0.0;
+  c.height=0.0;
+  c.have_orientation=false;
+  c.orientation=0.0;
+  c.id=-1;
+  c.pattern_idx=-1;
+  c.id_age=0;
+  candidates.push_back(c);
+  return candidates.back();
+}
 
-  int size=robots->size();
-  SSL_DetectionRobot * result_robot = 0;
-  for (int i=0;i<size;i++) {
-    if (robots->Get(i).confidence() < conf) {
-      //allocate new robot at end of array
-      //and shift everything down by 1...making room for newly inserted item.
-      if (size < max_robots) {
-        //we can expand the array by 1.
-        robots->Add();
-        size++;
-      }
-      for (int j=size-1; j>i; j--) {
-        (*(robots->Mutable(j)))=robots->Get(j-1);
-      }
-      result_robot = robots->Mutable(i);
-      result_robot->Clear();
-      result_robot->set_confidence(conf);
+int TeamDetector::rankCandidates(int max_candidates) {
+  int num=std::min((int)candidates.size(),std::max(max_candidates,0));
+  std::partial_sort(candidates.begin(),candidates.begin()+num,candidates.end(),
+                    [](const Candidate & a, const Candidate & b) {
+    return a.conf > b.conf || (a.conf == b.conf && a.index < b.index);
+  });
+  return num;
+}
 
-      return result_robot;
-    }
+void TeamDetector::writeRobots(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots, int num, int max_robots) {
+  for (int i=0; i<num && robots->size() < max_robots; i++) {
+    const Candidate & c=candidates[i];
+    if (c.conf == 0.0) continue;
+    SSL_DetectionRobot * robot=robots->Add();
+    robot->set_confidence(c.conf);
+    robot->set_x(c.x);
+    robot->set_y(c.y);
+    if (c.have_orientation) robot->set_orientation(c.orientation);
+    if (c.id >= 0) robot->set_robot_id(c.id);
+    robot->set_pixel_x(c.pixel_x);
+    robot->set_pixel_y(c.pixel_y);
+    robot->set_height(c.height);
   }
-  if (size < max_robots) {
-    result_robot = robots->Add();
-    result_robot->set_confidence(conf);
-  }
-  return result_robot;
 }
 
-
-void TeamDetector::stripRobots(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots) {
-  int size=robots->size();
-
-  int tgt=0;
-  for (int src=0;src<size;src++) {
-    if (robots->Get(src).confidence() != 0.0) {
-      if (tgt!=src) {
-        //copy operation is needed:
-        (*(robots->Mutable(tgt)))=robots->Get(src);
-      }
-      tgt++;
+const TeamDetector::CachedRobot * TeamDetector::findCachedRobot(const vector2f & loc) const {
+  const CachedRobot * nearest=0;
+  double nearest_sqdist=sq(_id_cache_gating_radius);
+  for (unsigned int i=0; i<id_cache.size(); i++) {
+    double d=sq((double)id_cache[i].x - loc.x) + sq((double)id_cache[i].y - loc.y);
+    if (d < nearest_sqdist) {
+      nearest=&id_cache[i];
+      nearest_sqdist=d;
     }
   }
-  for (int i=tgt;i<size;i++) {
-    robots->RemoveLast();
+  return nearest;
+}
+
+void TeamDetector::updateIdCache(int num, int max_robots) {
+  id_cache.clear();
+  for (int i=0; i<num && (int)id_cache.size() < max_robots; i++) {
+    const Candidate & c=candidates[i];
+    if (c.conf == 0.0) continue;
+    CachedRobot cached;
+    cached.x=c.x;
+    cached.y=c.y;
+    cached.pattern_idx=c.pattern_idx;
+    cached.id_age=c.id_age;
+    id_cache.push_back(cached);
   }
 }
 
@@ -413,13 +461,14 @@ void TeamDetector::stripRobots(::google::protobuf::RepeatedPtrField< ::SSL_Detec
 
 
 
-void TeamDetector::findRobotsByModel(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots, int team_color_id, const Image<raw8> * image, CMVision::ColorRegionList * colorlist, CMVision::RegionTree & reg_tree)
+void TeamDetector::findRobotsByModel(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots, int team_color_id, const Image<raw8> * image, CMVision::ColorRegionList * colorlist, const CMVision::RegionTree & reg_tree)
 {
 
   (void)image;
   const int MaxDetections = _other_markers_max_detections;
   Marker cen; // center marker
-  Marker *markers = new Marker[MaxDetections];
+  if ((int)marker_buffer.size() < MaxDetections) marker_buffer.resize(MaxDetections);
+  Marker *markers = marker_buffer.data();
   const float marker_max_query_dist = _other_markers_max_query_distance;
   const float marker_max_dist = _pattern_max_dist;
 
@@ -428,14 +477,14 @@ void TeamDetector::findRobotsByModel(::google::protobuf::RepeatedPtrField< ::SSL
 
   filter_team.init( colorlist->getRegionList(team_color_id).getInitialElement());
   const CMVision::Region * reg=0;
-  SSL_DetectionRobot * robot=0;
+  candidates.clear();
 
   MultiPatternModel::PatternDetectionResult res;
 
   while((reg = filter_team.getNext()) != 0) {
     vector2d reg_img_center(reg->cen_x,reg->cen_y);
     vector3d reg_center3d;
-    _camera_params.image2field(reg_center3d,reg_img_center,_robot_height);
+    _robot_height_table.image2field(reg_center3d,reg_img_center);
     vector2d reg_center(reg_center3d.x,reg_center3d.y);
     //TODO add masking:
     //if(det.mask.get(reg->cen_x,reg->cen_y) >= 0.5){
@@ -443,17 +492,17 @@ void TeamDetector::findRobotsByModel(::google::protobuf::RepeatedPtrField< ::SSL
       cen.set(reg,reg_center3d,getRegionArea(reg,_robot_height));
       int num_markers = 0;
 
-      reg_tree.startQuery(*reg,marker_max_query_dist);
+      reg_tree.startQuery(reg_tree_query,*reg,marker_max_query_dist);
       double sd=0.0;
       CMVision::Region *mreg;
-      while((mreg=reg_tree.getNextNearest(sd))!=0 && num_markers<MaxDetections) {
+      while((mreg=reg_tree.getNextNearest(reg_tree_query,sd))!=0 && num_markers<MaxDetections) {
         //TODO: implement masking:
         // filter_other.check(*mreg) && det.mask.get(mreg->cen_x,mreg->cen_y)>=0.5
 
         if(filter_others.check(*mreg) && model.usesColor(mreg->color)) {
           vector2d marker_img_center(mreg->cen_x,mreg->cen_y);
           vector3d marker_center3d;
-          _camera_params.image2field(marker_center3d,marker_img_center,_robot_height);
+          _robot_height_table.image2field(marker_center3d,marker_img_center);
           Marker &m = markers[num_markers];
 
           m.set(mreg,marker_center3d,getRegionArea(mreg,_robot_height));
@@ -466,7 +515,7 @@ void TeamDetector::findRobotsByModel(::google::protobuf::RepeatedPtrField< ::SSL
           }
         }
       }
-      reg_tree.endQuery();
+      reg_tree.endQuery(reg_tree_query);
 
       if(num_markers >= 2){
         CMPattern::PatternProcessing::sortMarkersByAngle(markers,num_markers);
@@ -485,31 +534,42 @@ void TeamDetector::findRobotsByModel(::google::protobuf::RepeatedPtrField< ::SSL
           markers[i].next_angle_dist = angle_pos(angle_diff(markers[i].angle,markers[j].angle));
         }
 
-        if (model.findPattern(res,markers,num_markers,_pattern_fit_params,_camera_params)) {
-              robot=addRobot(robots,res.conf,_max_robots*2);
-              if (robot!=0) {
-                //setup robot:
-                robot->set_x(cen.loc.x);
-                robot->set_y(cen.loc.y);
-                if (_have_angle) robot->set_orientation(res.angle);
-                robot->set_robot_id(res.id);
-                robot->set_pixel_x(reg->cen_x);
-                robot->set_pixel_y(reg->cen_y);
-                robot->set_height(cen.height);
-              }
+        //a robot seen near here in the last frame most likely still has the
+        //same pattern, which is much cheaper to confirm than to search for.
+        //Every so often the full search runs anyway, in case ids got swapped.
+        bool found=false;
+        int id_age=0;
+        const CachedRobot * cached=(_id_cache_enable ? findCachedRobot(cen.loc) : 0);
+        if (cached!=0 && cached->id_age < _id_cache_full_check_interval) {
+          found=model.checkPattern(res,cached->pattern_idx,markers,num_markers,_pattern_fit_params,*_calibration);
+          if (found) id_age=cached->id_age+1;
+        }
+        if (!found) {
+          found=model.findPattern(res,markers,num_markers,_pattern_fit_params,*_calibration);
+        }
+
+        if (found) {
+              Candidate & robot=addCandidate(res.conf);
+              robot.x=cen.loc.x;
+              robot.y=cen.loc.y;
+              robot.have_orientation=_have_angle;
+              robot.orientation=res.angle;
+              robot.id=res.id;
+              robot.pixel_x=reg->cen_x;
+              robot.pixel_y=reg->cen_y;
+              robot.height=cen.height;
+              robot.pattern_idx=res.idx;
+              robot.id_age=id_age;
         }
       }
     }
   }
-  //remove items with 0-confidence:
-  stripRobots(robots);
 
-  //remove extra items:
-  while(robots->size() > _max_robots) {
-    robots->RemoveLast();
-  }
+  //write all but the items with 0-confidence:
+  int num=rankCandidates(_max_robots*2);
+  writeRobots(robots,num,_max_robots);
 
-  delete[] markers;
+  if (_id_cache_enable) updateIdCache(num,_max_robots);
 }
 
 
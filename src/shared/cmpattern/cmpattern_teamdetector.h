@@ -30,6 +30,7 @@
 #include "cmvision_region.h"
 #include "field.h"
 #include "camera_calibration.h"
+#include "image2field_table.h"
 #include "field_filter.h"
 #include "vis_util.h"
 #include "cmvision_histogram.h"
@@ -161,6 +162,10 @@ protected:
   //TeamDetectorSettings * _detector_settings;
 
   const CameraParameters& _camera_params;
+  // the calibration of the current frame
+  std::shared_ptr<const CameraParameters::Snapshot> _calibration;
+  // field positions of all pixels at the robot height of the team
+  Image2FieldTable _robot_height_table;
   const RoboCupField& _field;
   RobotPattern * _robotPattern;
   Team * _team;
@@ -171,6 +176,8 @@ protected:
   //-----TEAM CONFIG---------
   CMVision::RegionFilter filter_team;
   CMVision::RegionFilter filter_others;
+  // own query state, so that the detectors of both teams can share a region tree
+  CMVision::RegionTree::Query reg_tree_query;
   bool   _unique_patterns;
   bool   _have_angle;
   bool   _load_markers_from_image_file;
@@ -189,7 +196,11 @@ protected:
   double _other_markers_max_query_distance;
 
   bool  _histogram_enable;
+  // whether the histogram check runs in the current frame
+  bool  _histogram_check;
   int    _histogram_pixel_scan_radius;
+  // the integral histogram of the current frame, if any
+  const CMVision::IntegralHistogram * _integral_histogram;
 
   ClosedRangeFloat _histogram_markeryness;
   ClosedRangeFloat _histogram_field_greenness;
@@ -198,6 +209,10 @@ protected:
   double _pattern_max_dist;
   MultiPatternModel::PatternFitParameters _pattern_fit_params;
 
+  bool   _id_cache_enable;
+  double _id_cache_gating_radius;
+  int    _id_cache_full_check_interval;
+
   //----END OF TEAM CONFIG---------
 
   //color ids:
@@ -210,16 +225,59 @@ protected:
   int color_id_white;
   int color_id_team;
 
+  //a detected robot, before it is written to the detection frame
+  struct Candidate {
+    float conf;
+    //order of detection, which breaks ties in confidence
+    int index;
+    float x;
+    float y;
+    float pixel_x;
+    float pixel_y;
+    float height;
+    bool have_orientation;
+    float orientation;
+    //-1 if the robot was found by its team marker only
+    int id;
+    int pattern_idx;
+    //frames since the pattern was found by a search of all patterns
+    int id_age;
+  };
+
+  //a robot of the last frame, whose pattern is tried first for a center
+  //marker near its position
+  struct CachedRobot {
+    float x;
+    float y;
+    int pattern_idx;
+    int id_age;
+  };
+
+  //reused from frame to frame, so that detection does not allocate
+  std::vector<Candidate> candidates;
+  std::vector<Marker> marker_buffer;
+  std::vector<CachedRobot> id_cache;
+
 protected:
     double getRegionArea(const CMVision::Region * reg, double z) const;
     bool checkHistogram(const CMVision::Region * reg, const Image<raw8> * image);
 
-    //returns a mutable pointer if the add was successful
-    //returns 0 if there already are max_robots with higher confidence than conf
-    SSL_DetectionRobot * addRobot(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots, double conf, int max_robots);
+    //adds a candidate with the given confidence and returns it, for the caller to fill in
+    Candidate & addCandidate(double conf);
 
-    //remove anything with a confidence of 0:
-    void stripRobots(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots);
+    //moves the max_candidates candidates of highest confidence to the front, ordered
+    //by confidence and then by order of detection. Returns how many there are.
+    int rankCandidates(int max_candidates);
+
+    //writes the ranked candidates [0,num) with a confidence other than 0 to
+    //robots, up to max_robots of them
+    void writeRobots(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots, int num, int max_robots);
+
+    //the cached robot nearest to loc within the gating radius, or 0
+    const CachedRobot * findCachedRobot(const vector2f & loc) const;
+
+    //replaces the id cache with the robots that writeRobots() wrote
+    void updateIdCache(int num, int max_robots);
 
 public:
     TeamDetector(LUT3D * lut3d, const CameraParameters& camera_params, const RoboCupField& field);
@@ -233,11 +291,16 @@ public:
 
     void init(RobotPattern * robotPattern, Team * team);
 
-    void findRobotsByModel(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots, int team_color_id, const Image<raw8> * image, CMVision::ColorRegionList * colorlist, CMVision::RegionTree & reg_tree);
+    /// whether the histogram check reads the channel \p color_id, besides the team color
+    bool usesHistogramChannel(int color_id) const;
+
+    void findRobotsByModel(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots, int team_color_id, const Image<raw8> * image, CMVision::ColorRegionList * colorlist, const CMVision::RegionTree & reg_tree);
 
     void findRobotsByTeamMarkerOnly(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots, int team_color_id, const Image<raw8> * image, CMVision::ColorRegionList * colorlist);
 
-    void update(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots, int team_color_id, int max_robots, const Image<raw8> * image, CMVision::ColorRegionList * colorlist, CMVision::RegionTree & reg_tree);
+    /// \p integral_histogram, if not null, answers the histogram checks instead of \p image.
+    /// The histogram checks are skipped if \p image is empty.
+    void update(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots, int team_color_id, int max_robots, int image_width, int image_height, const Image<raw8> * image, CMVision::ColorRegionList * colorlist, const CMVision::RegionTree & reg_tree, const CMVision::IntegralHistogram * integral_histogram=0);
 };
 
 }
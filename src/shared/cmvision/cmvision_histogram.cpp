@@ -19,9 +19,139 @@
 */
 //========================================================================
 #include "cmvision_histogram.h"
+#include <string.h>
+#include <algorithm>
+#include "worker_pool.h"
 
 namespace CMVision {
 
+IntegralHistogram::IntegralHistogram()
+{
+  image=0;
+  width=0;
+  height=0;
+  num_channels=0;
+}
+
+void IntegralHistogram::clear() {
+  image=0;
+}
+
+bool IntegralHistogram::isEmpty() const {
+  return image==0;
+}
+
+const Image<raw8> * IntegralHistogram::getImage() const {
+  return image;
+}
+
+int IntegralHistogram::getNumChannels() const {
+  return num_channels;
+}
+
+void IntegralHistogram::build(const Image<raw8> * _image, const std::vector<int> & channels, WorkerPool * pool) {
+  image=_image;
+  width=image->getWidth();
+  height=image->getHeight();
+  channel_labels.clear();
+  for (unsigned int i=0; i<channels.size(); i++) {
+    int label=channels[i];
+    if (label >= 0 && label < 256 &&
+        std::find(channel_labels.begin(),channel_labels.end(),label) == channel_labels.end()) {
+      channel_labels.push_back(label);
+    }
+  }
+  num_channels=channel_labels.size();
+  //a row of zeros for each label, with a one at the table of the label if it has one:
+  one_hot.assign(256*num_channels,0);
+  for (int c=0; c<num_channels; c++) one_hot[channel_labels[c]*num_channels + c]=1;
+  size_t row_entries=(size_t)(width+1)*num_channels;
+  sums.resize(row_entries*(height+1));
+  //the first row stays zero:
+  memset(sums.data(),0,row_entries*sizeof(uint16_t));
+
+  int bands = (pool==0) ? 1 : pool->getConcurrency();
+  if (bands > height) bands=height;
+  if (bands <= 1) {
+    sumRows(0,height,true);
+    return;
+  }
+
+  //every band sums its rows as if it was the top of the image, then adds the
+  //totals of all bands above it:
+  pool->run("IntegralHistogram", bands, [&](int band) {
+    int row_begin, row_end;
+    WorkerPool::splitRange(height, bands, band, row_begin, row_end);
+    sumRows(row_begin,row_end,band==0);
+  });
+  band_offsets.resize(row_entries*bands);
+  memset(band_offsets.data(),0,row_entries*sizeof(uint16_t));
+  for (int band=1; band<bands; band++) {
+    int row_begin, row_end;
+    WorkerPool::splitRange(height, bands, band-1, row_begin, row_end);
+    const uint16_t * previous=band_offsets.data() + (band-1)*row_entries;
+    //the last row of the band above holds the totals of that band only, except for band 0:
+    const uint16_t * bottom=sums.data() + row_end*row_entries;
+    uint16_t * offset=band_offsets.data() + band*row_entries;
+    for (size_t i=0; i<row_entries; i++) {
+      offset[i]=(uint16_t)(bottom[i] + (band > 1 ? previous[i] : 0));
+    }
+  }
+  pool->run("IntegralHistogramOffsets", bands-1, [&](int band) {
+    band++;
+    int row_begin, row_end;
+    WorkerPool::splitRange(height, bands, band, row_begin, row_end);
+    const uint16_t * offset=band_offsets.data() + band*row_entries;
+    for (int y=row_begin; y<row_end; y++) {
+      uint16_t * row=sums.data() + (y+1)*row_entries;
+      for (size_t i=0; i<row_entries; i++) {
+        row[i]=(uint16_t)(row[i]+offset[i]);
+      }
+    }
+  });
+}
+
+void IntegralHistogram::sumRows(int row_begin, int row_end, bool top) {
+  const raw8 * data = image->getPixelData();
+  const uint16_t * one_hot_rows = one_hot.data();
+  const int n = num_channels;
+  const int w = width;
+  size_t row_entries=(size_t)(w+1)*n;
+  for (int y=row_begin; y<row_end; y++) {
+    const raw8 * src = data + y*w;
+    //the first row of a band starts from zero, instead of from the row above:
+    const uint16_t * above = (y==row_begin && !top) ? sums.data() : sums.data() + y*row_entries;
+    uint16_t * dst = sums.data() + (y+1)*row_entries;
+    uint16_t counts[256];
+    memset(counts,0,n*sizeof(uint16_t));
+    memset(dst,0,n*sizeof(uint16_t));
+    for (int x=0; x<w; x++) {
+      //counting through a one-hot row per label keeps the channel loop branch-free:
+      const uint16_t * label=one_hot_rows + src[x].v*n;
+      above+=n;
+      dst+=n;
+      for (int c=0; c<n; c++) {
+        counts[c]=(uint16_t)(counts[c]+label[c]);
+        dst[c]=(uint16_t)(counts[c]+above[c]);
+      }
+    }
+  }
+}
+
+void IntegralHistogram::addBox(int * counts, int max_channels, int x1, int y1, int x2, int y2) const {
+  size_t row_entries=(size_t)(width+1)*num_channels;
+  const uint16_t * top_left = sums.data() + y1*row_entries + x1*num_channels;
+  const uint16_t * top_right = sums.data() + y1*row_entries + (x2+1)*num_channels;
+  const uint16_t * bottom_left = sums.data() + (y2+1)*row_entries + x1*num_channels;
+  const uint16_t * bottom_right = sums.data() + (y2+1)*row_entries + (x2+1)*num_channels;
+  for (int c=0; c<num_channels; c++) {
+    int label = channel_labels[c];
+    if (label >= max_channels) continue;
+    //wraps around correctly, as long as the true count fits into 16 bits:
+    counts[label]+=(uint16_t)(bottom_right[c] - bottom_left[c] - top_right[c] + top_left[c]);
+  }
+}
+
 Histogram::Histogram(int _max_channels)
 {
   if (_max_channels < 1) _max_channels=1;
@@ -39,6 +169,7 @@ int Histogram::addBox(const Image<raw8> * image, int x1, int y1, int x2, int y2)
   raw8 * data = image->getPixelData();
   int image_width = image->getWidth();
   int image_height = image->getHeight();
+  if (image_width <= 0 || image_height <= 0) return 0;
 
   x1 = bound(x1,0,image_width-1);
   y1 = bound(y1,0,image_height-1);
@@ -54,6 +185,25 @@ int Histogram::addBox(const Image<raw8> * image, int x1, int y1, int x2, int y2)
   return((x2 - x1 + 1) * (y2 - y1 + 1));
 }
 
+int Histogram::addBox(const IntegralHistogram * integral, int x1, int y1, int x2, int y2) {
+  const Image<raw8> * image = integral->getImage();
+  int image_width = image->getWidth();
+  int image_height = image->getHeight();
+  if (image_width <= 0 || image_height <= 0) return 0;
+
+  x1 = bound(x1,0,image_width-1);
+  y1 = bound(y1,0,image_height-1);
+  x2 = bound(x2,0,image_width-1);
+  y2 = bound(y2,0,image_height-1);
+
+  int area = (x2 - x1 + 1) * (y2 - y1 + 1);
+  if (x2 < x1 || y2 < y1 || area > IntegralHistogram::MAX_BOX_AREA) {
+    return addBox(image,x1,y1,x2,y2);
+  }
+  integral->addBox(channels,max_channels,x1,y1,x2,y2);
+  return area;
+}
+
 int Histogram::getChannel(int channel) {
   return channels[channel];
 }
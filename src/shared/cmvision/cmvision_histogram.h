@@ -20,10 +20,55 @@
 //========================================================================
 #ifndef CMVISION_HISTOGRAM_H
 #define CMVISION_HISTOGRAM_H
+#include <stdint.h>
+#include <vector>
 #include "image.h"
 
+class WorkerPool;
+
 namespace CMVision {
 
+/// Summed-area tables of selected channels of a color-labeled image, from which the
+/// histogram of any box is read in constant time.
+/// The sums are kept modulo 2^16, which is exact for boxes of less than 65536 pixels.
+class IntegralHistogram{
+protected:
+    const Image<raw8> * image;
+    int width;
+    int height;
+    //the number of tables
+    int num_channels;
+    //the label counted by each table
+    std::vector<int> channel_labels;
+    //(height+1) rows of (width+1) entries of num_channels sums each. The sums of
+    //entry (x,y) cover the pixels left of x and above y.
+    std::vector<uint16_t> sums;
+    //per label, the increments of the sums of all channels
+    std::vector<uint16_t> one_hot;
+    //the totals of all rows above each band, when built in parallel
+    std::vector<uint16_t> band_offsets;
+
+    void sumRows(int row_begin, int row_end, bool top);
+public:
+    static const int MAX_BOX_AREA = 0xFFFF;
+
+    IntegralHistogram();
+
+    /// computes the tables of the label image for the labels in \p channels only.
+    /// The image must stay unchanged for as long as boxes are read.
+    void build(const Image<raw8> * image, const std::vector<int> & channels, WorkerPool * pool=0);
+    /// marks the tables as not holding the current frame
+    void clear();
+    bool isEmpty() const;
+    const Image<raw8> * getImage() const;
+    int getNumChannels() const;
+
+    /// adds the pixel counts of the box [x1,x2]x[y1,y2], which must lie inside of the image
+    /// and cover at most MAX_BOX_AREA pixels, to counts[label] of the labels that have a
+    /// table and are less than max_channels. The counts of other labels are left unchanged.
+    void addBox(int * counts, int max_channels, int x1, int y1, int x2, int y2) const;
+};
+
 class Histogram{
 protected:
     int * channels;
@@ -35,6 +80,9 @@ public:
     //will sample a rectangular bounding box of a color-labeled image and add it to the histogram
     //the return value is the area of the box.
     int addBox(const Image<raw8> * image, int x1, int y1, int x2, int y2);
+    //same as addBox() on the image the integral histogram was built from, in constant time,
+    //but only counts the channels the integral histogram was built for
+    int addBox(const IntegralHistogram * integral, int x1, int y1, int x2, int y2);
     int getChannel(int channel);
     void setChannel(int channel, int value);
     void clear();
@@ -21,6 +21,91 @@
 */
 //========================================================================
 #include "cmvision_region.h"
+#include "worker_pool.h"
+#include <algorithm>
+
+#if defined(__x86_64__)
+#define CMV_REGION_X86
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+// Returns the first position in [x,end) whose label differs from m, or
+// end if there is none. The vector versions compare a whole register of
+// labels at once and jump straight to the first difference, so the cost
+// of a long run (e.g. the background) hardly depends on its length.
+typedef int (*RunEndFinder)(const uint8_t * row, int x, int end, uint8_t m);
+
+int findRunEndScalar(const uint8_t * row, int x, int end, uint8_t m) {
+  while(x != end && row[x] == m) x++;
+  return x;
+}
+
+#ifdef CMV_REGION_X86
+
+// SSE2 is part of every x86-64 cpu, it is used for the SSE4.1 level
+int findRunEndSSE2(const uint8_t * row, int x, int end, uint8_t m) {
+  __m128i mv=_mm_set1_epi8((char)m);
+  for (; x + 16 <= end; x+=16) {
+    __m128i d=_mm_loadu_si128((const __m128i *)(row + x));
+    unsigned int diff=(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(d,mv)) ^ 0xFFFFu;
+    if (diff != 0) return x + __builtin_ctz(diff);
+  }
+  return findRunEndScalar(row, x, end, m);
+}
+
+__attribute__((target("avx2")))
+int findRunEndAVX2(const uint8_t * row, int x, int end, uint8_t m) {
+  __m256i mv=_mm256_set1_epi8((char)m);
+  for (; x + 32 <= end; x+=32) {
+    __m256i d=_mm256_loadu_si256((const __m256i *)(row + x));
+    unsigned int diff=~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(d,mv));
+    if (diff != 0) return x + __builtin_ctz(diff);
+  }
+  return findRunEndScalar(row, x, end, m);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+int findRunEndAVX512(const uint8_t * row, int x, int end, uint8_t m) {
+  __m512i mv=_mm512_set1_epi8((char)m);
+  for (; x + 64 <= end; x+=64) {
+    __m512i d=_mm512_loadu_si512((const void *)(row + x));
+    unsigned long long diff=(unsigned long long)_mm512_cmpneq_epi8_mask(d,mv);
+    if (diff != 0) return x + __builtin_ctzll(diff);
+  }
+  return findRunEndScalar(row, x, end, m);
+}
+
+#endif
+
+// the default color selection of the blob finder: everything but the background
+class AllColors {
+public:
+  bool used[256];
+  AllColors() {
+    used[0]=false;
+    for (int i=1; i<256; i++) used[i]=true;
+  }
+};
+const AllColors all_colors;
+
+RunEndFinder runEndFinder() {
+#ifdef CMV_REGION_X86
+  switch (CMVisionThreshold::getSimdLevel()) {
+    case CMVisionThreshold::SimdAVX512: return findRunEndAVX512;
+    case CMVisionThreshold::SimdAVX2: return findRunEndAVX2;
+    case CMVisionThreshold::SimdSSE41: return findRunEndSSE2;
+    default: break;
+  }
+#endif
+  return findRunEndScalar;
+}
+
+}
 
 namespace CMVision {
 
@@ -34,67 +119,180 @@ RegionProcessing::~RegionProcessing()
 }
 
 
-void RegionProcessing::encodeRuns(Image<raw8> * tmap, CMVision::RunList * runlist)
-// Changes the flat array version of the thresholded image into a run
-// length encoded version, which speeds up later processing since we
-// only have to look at the points where values change.
+int RegionProcessing::encodeRow(const raw8 * row, int width, int y, CMVision::Run * runs, int j, int max_runs)
+// Appends the runs of a single row to runs[j...] and returns the new
+// number of runs. Stops as soon as max_runs is reached.
 {
+  raw8 clear(0);
+  raw8 m;
+  int x,l;
+  CMVision::Run r;
+  RunEndFinder findRunEnd = runEndFinder();
+  const uint8_t * labels = (const uint8_t *)row;
 
-  int max_runs = runlist->getMaxRuns();
-  CMVision::Run * runs = runlist->getRunArrayPointer();
-  raw8 * map = tmap->getPixelData();
-  int width=tmap->getWidth();
-  int height=tmap->getHeight();
+  r.next = 0;
+  r.y = y;
 
+  x = 0;
+  while(x < width){
+    m = row[x];
+    r.x = x;
+
+    l = x;
+
+    //never reads beyond the row end
+    x = findRunEnd(labels, x + 1, width, m.v);
+
+    if(m != clear || x==width) {
+      r.color = m;
+      r.width = x - l;
+      r.parent = j;
+      runs[j++] = r;
+
+      if(j >= max_runs) return j;
+    }
+  }
+  return j;
+}
 
+int RegionProcessing::encodeRowSpans(const raw8 * row, int width, int y, const MaskSpan * spans_begin,
+                                     const MaskSpan * spans_end, CMVision::Run * runs, int j, int max_runs)
+// Same as encodeRow(), but only looks at the pixels inside the spans. All
+// other pixels are taken to be 0, which leaves a single background run at
+// the end of the row to be emitted.
+{
   raw8 clear(0);
   raw8 m;
-  raw8 *row;
-  int x,y,j,l;
+  int x,l;
+  int last_end = 0;
   CMVision::Run r;
+  RunEndFinder findRunEnd = runEndFinder();
+  const uint8_t * labels = (const uint8_t *)row;
 
   r.next = 0;
+  r.y = y;
 
-  j = 0;
-  for(y=0; y<height; y++){
-    row = &map[y * width];
-
-    r.y = y;
-
-    x = 0;
-    while(x < width){
+  for(const MaskSpan * span=spans_begin; span!=spans_end; span++){
+    x = span->x_begin;
+    while(x < span->x_end){
       m = row[x];
-      r.x = x;
-
       l = x;
+      x = findRunEnd(labels, x + 1, span->x_end, m.v);
 
-      //fix by Stefan: stop if x==row-width
-      //(and don't access the row array in that case as it could cause a segfault)
-      //Note that the left argument of the && operator is always evaluated first and as
-      //such this expression should be safe.
-      while(x != width && row[x] == m) x++;
-
-      if(m != clear || x==width) {
+      if(m != clear) {
+        r.x = l;
         r.color = m;
         r.width = x - l;
         r.parent = j;
         runs[j++] = r;
+        last_end = x;
 
-        if(j >= max_runs){
-          runlist->setUsedRuns(j);
-          return;
-        }
+        if(j >= max_runs) return j;
+      }
+    }
+  }
+
+  if(last_end < width) {
+    r.x = last_end;
+    r.color = clear;
+    r.width = width - last_end;
+    r.parent = j;
+    runs[j++] = r;
+  }
+  return j;
+}
+
+void RegionProcessing::encodeRuns(Image<raw8> * tmap, CMVision::RunList * runlist)
+// Changes the flat array version of the thresholded image into a run
+// length encoded version, which speeds up later processing since we
+// only have to look at the points where values change.
+{
+  encodeRuns(tmap, runlist, 0, tmap->getHeight());
+}
+
+void RegionProcessing::encodeRuns(Image<raw8> * tmap, CMVision::RunList * runlist, int row_begin, int row_end)
+{
+  int max_runs = runlist->getMaxRuns();
+  CMVision::Run * runs = runlist->getRunArrayPointer();
+  raw8 * map = tmap->getPixelData();
+  int width=tmap->getWidth();
+
+  int j = 0;
+  for(int y=row_begin; y<row_end; y++){
+    // a row has at most one run per pixel, so it never hits max_runs
+    if(j + width > max_runs){
+      runlist->reserve(j + width);
+      runs = runlist->getRunArrayPointer();
+      max_runs = runlist->getMaxRuns();
+    }
+    j = encodeRow(&map[y * width], width, y, runs, j, max_runs);
+  }
+
+  runlist->setUsedRuns(j);
+}
+
+bool RegionProcessing::thresholdAndEncodeRuns(const RawImage * source, YUVLUT * lut, const ImageMaskSpans * spans,
+                                              CMVision::RunList * runlist, Image<raw8> * strip)
+// Same result as thresholding the whole image and calling encodeRuns()
+// on it, but only a strip of a few rows is thresholded at a time. The
+// strip stays in the cache while it is encoded, so the label image never
+// has to be written to and read back from memory. Masked pixels are
+// neither thresholded nor looked at by the encoder.
+{
+  return thresholdAndEncodeRuns(source, lut, spans, runlist, strip, 0, source->getHeight());
+}
+
+bool RegionProcessing::thresholdAndEncodeRuns(const RawImage * source, YUVLUT * lut, const ImageMaskSpans * spans,
+                                              CMVision::RunList * runlist, Image<raw8> * strip,
+                                              int row_begin, int row_end)
+{
+  int max_runs = runlist->getMaxRuns();
+  CMVision::Run * runs = runlist->getRunArrayPointer();
+  int width=source->getWidth();
+  int rows=row_end - row_begin;
+
+  runlist->setUsedRuns(0);
+  if (width==0 || rows<=0) return true;
+
+  int strip_rows = bound(ENCODE_STRIP_BYTES / width, 1, rows);
+  strip->allocate(width, strip_rows);
+  raw8 * labels = strip->getPixelData();
+
+  int j = 0;
+  for(int y=row_begin; y<row_end; y+=strip_rows){
+    int y_end = min(y + strip_rows, row_end);
+    if (CMVisionThreshold::thresholdRows((uint8_t*)labels, source, lut, spans, y, y_end, false)==false) {
+      runlist->setUsedRuns(j);
+      return false;
+    }
+    for(int row=y; row<y_end; row++){
+      if(j + width > max_runs){
+        runlist->reserve(j + width);
+        runs = runlist->getRunArrayPointer();
+        max_runs = runlist->getMaxRuns();
+      }
+      if (spans==0) {
+        j = encodeRow(&labels[(row - y) * width], width, row, runs, j, max_runs);
+      } else {
+        j = encodeRowSpans(&labels[(row - y) * width], width, row, spans->rowBegin(row), spans->rowEnd(row),
+                           runs, j, max_runs);
       }
     }
   }
 
   runlist->setUsedRuns(j);
+  return true;
 }
 
 
 
 
-void RegionProcessing::connectComponents(CMVision::RunList * runlist)
+const bool * RegionProcessing::selectColors(const bool * used_colors)
+{
+  return used_colors ? used_colors : all_colors.used;
+}
+
+void RegionProcessing::connectComponents(CMVision::RunList * runlist, const bool * used_colors)
 // Connect components using four-connecteness so that the runs each
 // identify the global parent of the connected region they are a part
 // of.  It does this by scanning adjacent rows and merging where
@@ -106,30 +304,38 @@ void RegionProcessing::connectComponents(CMVision::RunList * runlist)
 //   Read the papers on this library and have a good understanding of
 //   tree-based union find before you touch it
 {
+  connectRuns(runlist->getRunArrayPointer(), 0, runlist->getUsedRuns(), selectColors(used_colors));
+}
 
-  CMVision::Run * map=runlist->getRunArrayPointer();
-  int num = runlist->getUsedRuns();
+void RegionProcessing::connectRuns(CMVision::Run * map, int begin, int end, const bool * used_colors)
+// connectComponents() for the runs [begin,end), which have to start at
+// the beginning of a row. Every run ends up pointing at the lowest run
+// index of its component. Runs outside of the range are not accessed.
+{
   int l1,l2;
   CMVision::Run r1,r2;
   int i,j,s;
 
+  if(end - begin < 2) return;
+
   // l2 starts on first scan line, l1 starts on second
-  l2 = 0;
-  l1 = 1;
-  while(map[l1].y == 0) l1++; // skip first line
+  l2 = begin;
+  l1 = begin + 1;
+  while(l1 < end && map[l1].y == map[begin].y) l1++; // skip first line
+  if(l1 == end) return;
 
   // Do rest in lock step
   r1 = map[l1];
   r2 = map[l2];
   s = l1;
-  while(l1 < num){
+  while(l1 < end){
     /*
     printf("%6d:(%3d,%3d,%3d) %6d:(%3d,%3d,%3d)\n",
 	   l1,r1.x,r1.y,r1.width,
 	   l2,r2.x,r2.y,r2.width);
     */
 
-    if(r1.color==r2.color && r1.color.v!=0) {
+    if(r1.color==r2.color && used_colors[r1.color.v]) {
       // case 1: r2.x <= r1.x < r2.x + r2.width
       // case 2: r1.x <= r2.x < r1.x + r1.width
       if((r2.x<=r1.x && r1.x<r2.x+r2.width) ||
@@ -162,81 +368,169 @@ void RegionProcessing::connectComponents(CMVision::RunList * runlist)
 
     // Move to next point where values may change
     i = (r2.x + r2.width) - (r1.x + r1.width);
-    if(i >= 0) r1 = map[++l1];
+    if(i >= 0 && ++l1 < end) r1 = map[l1];
     if(i <= 0) r2 = map[++l2];
   }
 
   // Now we need to compress all parent paths
-  for(i=0; i<num; i++){
+  for(i=begin; i<end; i++){
     j = map[i].parent;
     map[i].parent = map[j].parent;
   }
 }
 
+void RegionProcessing::joinBandBorder(CMVision::Run * map, int upper_begin, int border, int lower_end,
+                                      const bool * used_colors, std::vector<int> & merged_roots)
+// Unions the components of the last row of a band, runs [upper_begin,border),
+// with those of the first row of the next band, runs [border,lower_end).
+// Both bands have to be labeled already. A root that is attached to another
+// root is appended to merged_roots.
+{
+  int l1 = border;
+  int l2 = upper_begin;
+  while(l1 < lower_end && l2 < border){
+    const CMVision::Run & r1 = map[l1];
+    const CMVision::Run & r2 = map[l2];
+    if(r1.color==r2.color && used_colors[r1.color.v] &&
+       ((r2.x<=r1.x && r1.x<r2.x+r2.width) || (r1.x<=r2.x && r2.x<r1.x+r1.width))){
+      int i = r1.parent;
+      while(i != map[i].parent) i = map[i].parent;
+      int j = r2.parent;
+      while(j != map[j].parent) j = map[j].parent;
+      if(i != j){
+        // keep the lower index as the root, as connectRuns() does
+        int root = min(i, j);
+        int child = max(i, j);
+        map[child].parent = root;
+        merged_roots.push_back(child);
+      }
+    }
+    int d = (r2.x + r2.width) - (r1.x + r1.width);
+    if(d >= 0) l1++;
+    if(d <= 0) l2++;
+  }
+}
+
+void RegionProcessing::connectComponents(CMVision::RunList * runlist, WorkerPool * pool, const bool * used_colors)
+{
+  CMVision::Run * map = runlist->getRunArrayPointer();
+  int num = runlist->getUsedRuns();
+  int bands = pool->getConcurrency();
+  if(bands == 1 || num == 0){
+    connectComponents(runlist, used_colors);
+    return;
+  }
+  used_colors = selectColors(used_colors);
+
+  // bands of whole rows, found by their first run
+  int first_row = map[0].y;
+  int rows = map[num - 1].y - first_row + 1;
+  bands = min(bands, rows);
+  std::vector<int> band_begin(bands + 1);
+  for(int b=0; b<bands; b++){
+    int row_begin, row_end;
+    WorkerPool::splitRange(rows, bands, b, row_begin, row_end);
+    CMVision::Run key;
+    key.y = first_row + row_begin;
+    band_begin[b] = (int)(std::lower_bound(map, map + num, key,
+      [](const CMVision::Run & a, const CMVision::Run & k) { return a.y < k.y; }) - map);
+  }
+  band_begin[bands] = num;
+
+  // label each band on its own; all runs then point to the lowest index of their
+  // component within the band
+  pool->run("ConnectComponents", bands, [&](int b) {
+    connectRuns(map, band_begin[b], band_begin[b + 1], used_colors);
+  });
+
+  // join the components that cross the borders between bands
+  std::vector<int> merged_roots;
+  for(int b=1; b<bands; b++){
+    int border = band_begin[b];
+    int upper_begin = border - 1;
+    while(upper_begin > 0 && map[upper_begin - 1].y == map[border - 1].y) upper_begin--;
+    int lower_end = border + 1;
+    while(lower_end < num && map[lower_end].y == map[border].y) lower_end++;
+    joinBandBorder(map, upper_begin, border, lower_end, used_colors, merged_roots);
+  }
+
+  // a merged root always points to a lower index, so resolving them in
+  // increasing order makes each point to its final root in one step
+  std::sort(merged_roots.begin(), merged_roots.end());
+  for(int r : merged_roots){
+    map[r].parent = map[map[r].parent].parent;
+  }
+
+  // every run points to a root of its band, which now points to the final root.
+  // A band only writes its own runs, and the final roots are never written.
+  pool->run("ConnectComponents", bands, [&](int b) {
+    for(int i=band_begin[b]; i<band_begin[b + 1]; i++){
+      int p = map[i].parent;
+      int root = map[p].parent;
+      if(root != p) map[i].parent = root;
+    }
+  });
+}
+
 
 
-void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::RunList * runlist)
+void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::RunList * runlist,
+                                      const bool * used_colors)
 // Takes the list of runs and formats them into a region table,
 // gathering the various statistics along the way.  num is the number
 // of runs in the rmap array, and the number of unique regions in
-// reg[] (bounded by max_reg) is returned.  Implemented as a single
-// pass over the array of runs.
+// reg[] is returned (the region list grows as needed).  Implemented as
+// a single pass over the array of runs.
 {
-  int b,i,n,a;
+  int b,i,n;
   CMVision::Run r;
   CMVision::Region * reg = reglist->getRegionArrayPointer();
+  CMVision::RegionStats & stats = reglist->getStats();
   CMVision::Run * rmap = runlist->getRunArrayPointer();
   int max_reg=reglist->getMaxRegions();
   int num = runlist->getUsedRuns();
+  used_colors = selectColors(used_colors);
 
   n = 0;
 
   for(i=0; i<num; i++){
-    if(rmap[i].color.v!=0){
+    if(used_colors[rmap[i].color.v]){
       r = rmap[i];
       if(r.parent == i){
         // Add new region if this run is a root (i.e. self parented)
+        if(n >= max_reg){
+          reglist->reserve(n + 1);
+          reg = reglist->getRegionArrayPointer();
+          max_reg = reglist->getMaxRegions();
+        }
         rmap[i].parent = b = n;  // renumber to point to region id
-        reg[b].color = r.color;
-        reg[b].area = r.width;
-        reg[b].x1 = r.x;
-        reg[b].y1 = r.y;
-        reg[b].x2 = r.x + r.width;
-        reg[b].y2 = r.y;
-        reg[b].cen_x = rangeSum(r.x,r.width);
-        reg[b].cen_y = r.y * r.width;
-        reg[b].run_start = i;
-        reg[b].iterator_id = i; // temporarily use to store last run
+        stats.start(b,r,i);
         n++;
-        if(n >= max_reg) {
-          reglist->setUsedRegions(max_reg);
-          return;
-        }
       }else{
         // Otherwise update region stats incrementally
         b = rmap[r.parent].parent;
         rmap[i].parent = b; // update parent to identify region id
-        reg[b].area += r.width;
-        reg[b].x2 = max(r.x + r.width,reg[b].x2);
-        reg[b].x1 = min((int)r.x,reg[b].x1);
-        reg[b].y2 = r.y; // last set by lowest run
-        reg[b].cen_x += rangeSum(r.x,r.width);
-        reg[b].cen_y += r.y * r.width;
         // set previous run to point to this one as next
-        rmap[reg[b].iterator_id].next = i;
-        reg[b].iterator_id = i;
+        rmap[stats.add(b,r,i)].next = i;
       }
     }
   }
 
-  // calculate centroids from stored sums
+  // copy the statistics into the regions, calculating centroids from stored sums
   for(i=0; i<n; i++){
-    a = reg[i].area;
-    reg[i].cen_x = (float)reg[i].cen_x / a;
-    reg[i].cen_y = (float)reg[i].cen_y / a;
-    rmap[reg[i].iterator_id].next = 0; // -1;
+    int first = stats.getFirstRun(i);
+    int last = stats.getLastRun(i);
+    reg[i].color = rmap[first].color;
+    reg[i].run_start = first;
+    reg[i].area = stats.getArea(i);
+    reg[i].x1 = stats.getX1(i);
+    reg[i].x2 = stats.getX2(i);
+    reg[i].y1 = rmap[first].y;
+    reg[i].y2 = rmap[last].y; // last set by lowest run
+    reg[i].cen_x = stats.getCenX(i);
+    reg[i].cen_y = stats.getCenY(i);
+    rmap[last].next = 0; // -1;
     reg[i].iterator_id = 0;
-    reg[i].x2--; // change to inclusive range
   }
 
   reglist->setUsedRegions(n);
@@ -422,19 +716,12 @@ void ImageProcessor::processYUV444(const ImageInterface * image, int min_blob_ar
 
 void ImageProcessor::processThresholded(Image<raw8> * _img_thresholded, int min_blob_area) {
   CMVision::RegionProcessing::encodeRuns(_img_thresholded, runlist);
-  if (runlist->getUsedRuns() == runlist->getMaxRuns()) {
-    printf("Warning: runlength encoder exceeded current max run size of %d\n",runlist->getMaxRuns());
-  }
   //Connect the components of the runlength map:
   CMVision::RegionProcessing::connectComponents(runlist);
 
   //Extract Regions from runlength map:
   CMVision::RegionProcessing::extractRegions(reglist, runlist);
 
-  if (reglist->getUsedRegions() == reglist->getMaxRegions()) {
-    printf("Warning: Region: extract regions exceeded maximum number of %d regions\n",reglist->getMaxRegions());
-  }
-
   //Separate Regions by colors:
   int max_area = CMVision::RegionProcessing::separateRegions(colorlist, reglist, min_blob_area);
 
@@ -27,14 +27,22 @@
 #include "nkdtree.h"
 #include "cmvision_threshold.h"
 #include "lut3d.h"
+#include <algorithm>
+#include <vector>
+
+class WorkerPool;
 
 namespace CMVision {
 
 
+// Runs are streamed through every stage of the blob finder, so they are
+// kept at 16 bytes: 16 bit coordinates cover images of up to 65535x65535
+// pixels. The parent and next indices stay next to the coordinates, as the
+// union-find of connectComponents() reads them together.
 class Run{
 public:
-  int x,y,width;    // location and width of run
-  raw8 color;       // which color(s) this run represents
+  uint16_t x,y,width; // location and width of run
+  raw8 color;         // which color(s) this run represents
   int parent,next;    // parent run and next run in run list
 };
 
@@ -50,6 +58,18 @@ public:
     max_runs=_max_runs;
     used_runs=0;
   }
+  /// grows the list to hold at least \p _runs runs, keeping its contents.
+  /// The capacity at least doubles and never shrinks, so it soon settles at
+  /// the high-water mark and steady-state frames do not allocate.
+  void reserve(int _runs) {
+    if (_runs <= max_runs) return;
+    int n=max(_runs, 2*max_runs);
+    Run * r=new Run[n];
+    std::copy(runs, runs + max_runs, r);
+    delete[] runs;
+    runs=r;
+    max_runs=n;
+  }
   void setUsedRuns(int runs) {
     used_runs=runs;
   }
@@ -68,6 +88,73 @@ public:
   }
 };
 
+/*!
+  \class   BandedRunList
+  \brief   Run lists of horizontal image bands that are encoded independently
+
+  Every band is encoded into its own segment, which uses band-local run
+  indices. join() then concatenates the segments in row order into the
+  run list of the whole image, which is the same as if the image had been
+  encoded in one go.
+*/
+class BandedRunList {
+private:
+  std::vector<RunList *> segments;
+  std::vector<Image<raw8> *> strips;
+public:
+  BandedRunList() {}
+  ~BandedRunList() {
+    clear();
+  }
+  void clear() {
+    for (unsigned int i=0; i<segments.size(); i++) {
+      delete segments[i];
+      delete strips[i];
+    }
+    segments.clear();
+    strips.clear();
+  }
+  /// makes sure there are \p bands segments, each starting out with room for \p initial_runs runs
+  void setup(int bands, int initial_runs) {
+    if ((int)segments.size()==bands) return;
+    clear();
+    for (int i=0; i<bands; i++) {
+      segments.push_back(new RunList(initial_runs));
+      strips.push_back(new Image<raw8>());
+    }
+  }
+  int getNumBands() const {
+    return (int)segments.size();
+  }
+  RunList * getSegment(int band) {
+    return segments[band];
+  }
+  /// scratch buffer of the band, for RegionProcessing::thresholdAndEncodeRuns()
+  Image<raw8> * getStrip(int band) {
+    return strips[band];
+  }
+  /// concatenates the segments into \p runlist
+  void join(RunList * runlist) {
+    int total=0;
+    for (unsigned int b=0; b<segments.size(); b++) {
+      total+=segments[b]->getUsedRuns();
+    }
+    runlist->reserve(total);
+    Run * runs=runlist->getRunArrayPointer();
+    int j=0;
+    for (unsigned int b=0; b<segments.size(); b++) {
+      const Run * src=segments[b]->getRunArrayPointer();
+      int n=segments[b]->getUsedRuns();
+      for (int i=0; i<n; i++) {
+        runs[j + i]=src[i];
+        runs[j + i].parent=src[i].parent + j;
+      }
+      j+=n;
+    }
+    runlist->setUsedRuns(j);
+  }
+};
+
 
 
 class Region{
@@ -92,17 +179,137 @@ class Region{
     {return(y2-y1+1);}
 };
 
+/*!
+  \class   RegionStats
+  \brief   Statistics of the regions while RegionProcessing::extractRegions() gathers them
+
+  Every statistic has an array of its own, indexed by region id. The pass
+  over the runs updates the region of each run in random order and only
+  touches these arrays, not the much larger Region entries with their list
+  and tree pointers. The Region entries are filled in one sequential pass
+  once all runs are done.
+*/
+class RegionStats {
+private:
+  int max_regions;
+  int * area;      // occupied area in pixels
+  int * x1;        // left end of the bounding box
+  int * x2;        // right end of the bounding box (exclusive)
+  float * sum_x;   // sum of the x coordinates of all pixels
+  float * sum_y;   // sum of the y coordinates of all pixels
+  int * first_run; // root run of the region, which also gives color and y1
+  int * last_run;  // last run added to the region, which also gives y2
+
+  template <typename T>
+  static void grow(T * & data, int used, int n) {
+    T * d=new T[n];
+    std::copy(data, data + used, d);
+    delete[] data;
+    data=d;
+  }
+public:
+  RegionStats(int _max_regions) {
+    max_regions=_max_regions;
+    area=new int[max_regions];
+    x1=new int[max_regions];
+    x2=new int[max_regions];
+    sum_x=new float[max_regions];
+    sum_y=new float[max_regions];
+    first_run=new int[max_regions];
+    last_run=new int[max_regions];
+  }
+  ~RegionStats() {
+    delete[] area;
+    delete[] x1;
+    delete[] x2;
+    delete[] sum_x;
+    delete[] sum_y;
+    delete[] first_run;
+    delete[] last_run;
+  }
+  /// grows the arrays to \p n entries, keeping the first \p used ones
+  void reserve(int used, int n) {
+    if (n <= max_regions) return;
+    grow(area, used, n);
+    grow(x1, used, n);
+    grow(x2, used, n);
+    grow(sum_x, used, n);
+    grow(sum_y, used, n);
+    grow(first_run, used, n);
+    grow(last_run, used, n);
+    max_regions=n;
+  }
+
+  inline void start(int reg, const Run & r, int run) {
+    area[reg]=r.width;
+    x1[reg]=r.x;
+    x2[reg]=r.x + r.width;
+    sum_x[reg]=(r.width * (2*r.x + r.width - 1)) / 2; // as RegionProcessing::rangeSum()
+    sum_y[reg]=r.y * r.width;
+    first_run[reg]=run;
+    last_run[reg]=run;
+  }
+  /// adds run \p r with index \p run to region \p reg, and returns the
+  /// index of the run that was added before it
+  inline int add(int reg, const Run & r, int run) {
+    area[reg]+=r.width;
+    x1[reg]=min((int)r.x, x1[reg]);
+    x2[reg]=max(r.x + r.width, x2[reg]);
+    sum_x[reg]+=(r.width * (2*r.x + r.width - 1)) / 2;
+    sum_y[reg]+=r.y * r.width;
+    int prev=last_run[reg];
+    last_run[reg]=run;
+    return prev;
+  }
+
+  int getArea(int reg) const {
+    return area[reg];
+  }
+  int getX1(int reg) const {
+    return x1[reg];
+  }
+  /// inclusive right end of the bounding box
+  int getX2(int reg) const {
+    return x2[reg] - 1;
+  }
+  float getCenX(int reg) const {
+    return sum_x[reg] / area[reg];
+  }
+  float getCenY(int reg) const {
+    return sum_y[reg] / area[reg];
+  }
+  int getFirstRun(int reg) const {
+    return first_run[reg];
+  }
+  int getLastRun(int reg) const {
+    return last_run[reg];
+  }
+};
+
 class RegionList {
 private:
   Region * regions;
+  RegionStats stats;
   int max_regions;
   int used_regions;
 public:
-  RegionList(int _max_regions) {
+  RegionList(int _max_regions) : stats(_max_regions) {
     regions=new Region[_max_regions];
     max_regions=_max_regions;
     used_regions=0;
   }
+  /// grows the list to hold at least \p _regions regions, keeping its contents
+  /// (see RunList::reserve()). Pointers to its regions become invalid.
+  void reserve(int _regions) {
+    if (_regions <= max_regions) return;
+    int n=max(_regions, 2*max_regions);
+    Region * r=new Region[n];
+    std::copy(regions, regions + max_regions, r);
+    delete[] regions;
+    regions=r;
+    stats.reserve(max_regions, n);
+    max_regions=n;
+  }
   void setUsedRegions(int regions) {
     used_regions=regions;
   }
@@ -116,6 +323,10 @@ public:
   Region * getRegionArrayPointer() const {
     return regions;
   }
+  /// scratch statistics of RegionProcessing::extractRegions(), sized like the region array
+  RegionStats & getStats() {
+    return stats;
+  }
   int getMaxRegions() const {
     return max_regions;
   }
@@ -286,6 +497,17 @@ protected:
     return(rs / 6);
   }
 
+  // size of the label strip used by thresholdAndEncodeRuns(), small enough to stay in L1
+  static const int ENCODE_STRIP_BYTES = 16384;
+
+  static int encodeRow(const raw8 * row, int width, int y, CMVision::Run * runs, int j, int max_runs);
+  static int encodeRowSpans(const raw8 * row, int width, int y, const MaskSpan * spans_begin,
+                            const MaskSpan * spans_end, CMVision::Run * runs, int j, int max_runs);
+  static void connectRuns(CMVision::Run * map, int begin, int end, const bool * used_colors);
+  static void joinBandBorder(CMVision::Run * map, int upper_begin, int border, int lower_end,
+                             const bool * used_colors, std::vector<int> & merged_roots);
+  static const bool * selectColors(const bool * used_colors);
+
 
 public:
     RegionProcessing();
@@ -293,8 +515,26 @@ public:
     ~RegionProcessing();
 
     static void encodeRuns(Image<raw8> * tmap, CMVision::RunList * runlist);
-    static void connectComponents(CMVision::RunList * runlist);
-    static void extractRegions(CMVision::RegionList * reglist, CMVision::RunList * runlist);
+    /// encodes rows [row_begin,row_end) only, with run indices starting at 0
+    static void encodeRuns(Image<raw8> * tmap, CMVision::RunList * runlist, int row_begin, int row_end);
+    /// thresholds and run-length encodes \p source in one pass, producing the same runs as
+    /// CMVisionThreshold followed by encodeRuns(). Only pixels inside \p spans (all if null)
+    /// are processed. \p strip is a scratch buffer kept by the caller.
+    static bool thresholdAndEncodeRuns(const RawImage * source, YUVLUT * lut, const ImageMaskSpans * spans,
+                                       CMVision::RunList * runlist, Image<raw8> * strip);
+    /// same for rows [row_begin,row_end) only, with run indices starting at 0
+    static bool thresholdAndEncodeRuns(const RawImage * source, YUVLUT * lut, const ImageMaskSpans * spans,
+                                       CMVision::RunList * runlist, Image<raw8> * strip, int row_begin, int row_end);
+    /// \p used_colors (256 entries, indexed by color id) selects the colors whose runs are
+    /// connected into regions, runs of all other colors are treated like the background.
+    /// If null, all colors but 0 are used.
+    static void connectComponents(CMVision::RunList * runlist, const bool * used_colors = 0);
+    /// same result as connectComponents(runlist), but row bands are labeled in parallel
+    /// by the threads of \p pool and then joined across their borders
+    static void connectComponents(CMVision::RunList * runlist, WorkerPool * pool, const bool * used_colors = 0);
+    /// \p used_colors has to be the same as for connectComponents()
+    static void extractRegions(CMVision::RegionList * reglist, CMVision::RunList * runlist,
+                               const bool * used_colors = 0);
     //returns the max area found:
     static int  separateRegions(CMVision::ColorRegionList * colorlist, CMVision::RegionList * reglist, int min_area);
 
@@ -316,6 +556,7 @@ protected:
   CMVision::RunList * runlist;
   Image<raw8> * img_thresholded;
 public:
+  /// the run and region lists start out with the given sizes and grow as needed
   ImageProcessor(YUVLUT * _lut, int _max_regions=10000, int _max_runs=50000);
   ~ImageProcessor();
   void processYUV422_UYVY(const RawImage * image, int min_blob_area);
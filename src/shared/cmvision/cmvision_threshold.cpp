@@ -20,10 +20,420 @@
 */
 //========================================================================
 #include "cmvision_threshold.h"
-#ifdef __AVX2__
-#include <x86intrin.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#define CMV_THRESHOLD_X86
+//some gcc versions report false positives for the placeholder
+//operands used inside the AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
 #endif
 
+namespace {
+
+/// the index computation of LUT3D, for use in the kernels below
+class LUTIndexer {
+public:
+  int x_shift;
+  int y_shift;
+  int z_shift;
+  int z_bits;
+  int z_and_y_bits;
+  int total_bits;
+  LUTIndexer(const LUT3D * lut) {
+    x_shift=lut->X_SHIFT;
+    y_shift=lut->Y_SHIFT;
+    z_shift=lut->Z_SHIFT;
+    z_bits=lut->Z_BITS;
+    z_and_y_bits=lut->Z_AND_Y_BITS;
+    total_bits=lut->TOTAL_BITS;
+  }
+  inline int index(int x, int y, int z) const {
+    return ((x >> x_shift) << z_and_y_bits) | ((y >> y_shift) << z_bits) | (z >> z_shift);
+  }
+};
+
+// A kernel thresholds the first pixels of a row-major run of n pixels and
+// returns how many it processed. The remainder is left to the scalar code.
+// The mask may be null if all pixels are to be thresholded.
+typedef int (*ThresholdKernel)(const uint8_t * src, uint8_t * dst, const uint8_t * mask, int n,
+                               const lut_mask_t * LUT, const LUTIndexer & ix);
+
+// scalar versions, also used for the tails that do not fill a vector
+inline void thresholdPacked3Scalar(const uint8_t * src, uint8_t * dst, const uint8_t * mask, int begin, int n,
+                                   const lut_mask_t * LUT, const LUTIndexer & ix) {
+  if (mask==0) {
+    for (int i=begin; i<n; i++) {
+      const uint8_t * p=src + 3*i;
+      dst[i] = LUT[ix.index(p[0],p[1],p[2])];
+    }
+    return;
+  }
+  for (int i=begin; i<n; i++) {
+    const uint8_t * p=src + 3*i;
+    dst[i] = mask[i] & LUT[ix.index(p[0],p[1],p[2])];
+  }
+}
+
+inline void thresholdUYVYScalar(const uint8_t * src, uint8_t * dst, const uint8_t * mask, int begin, int n,
+                                const lut_mask_t * LUT, const LUTIndexer & ix) {
+  if (mask==0) {
+    for (int i=begin; i<n; i++) {
+      const uint8_t * p=src + 4*(i >> 1);
+      int y = (i & 1) ? p[3] : p[1];
+      dst[i] = LUT[ix.index(y,p[0],p[2])];
+    }
+    return;
+  }
+  for (int i=begin; i<n; i++) {
+    const uint8_t * p=src + 4*(i >> 1);
+    int y = (i & 1) ? p[3] : p[1];
+    dst[i] = mask[i] & LUT[ix.index(y,p[0],p[2])];
+  }
+}
+
+#ifdef CMV_THRESHOLD_X86
+
+// All vector kernels build the LUT indices in 16 bit lanes, which holds
+// for every LUT of up to 16 index bits (the stacks use 15 and 16 bits).
+
+class SimdShifts {
+public:
+  __m128i x_shift;
+  __m128i y_shift;
+  __m128i z_shift;
+  __m128i z_bits;
+  __m128i z_and_y_bits;
+  SimdShifts(const LUTIndexer & ix) {
+    x_shift=_mm_cvtsi32_si128(ix.x_shift);
+    y_shift=_mm_cvtsi32_si128(ix.y_shift);
+    z_shift=_mm_cvtsi32_si128(ix.z_shift);
+    z_bits=_mm_cvtsi32_si128(ix.z_bits);
+    z_and_y_bits=_mm_cvtsi32_si128(ix.z_and_y_bits);
+  }
+};
+
+inline __m128i lutIndex128(__m128i x, __m128i y, __m128i z, const SimdShifts & s) {
+  return _mm_or_si128(_mm_sll_epi16(_mm_srl_epi16(x,s.x_shift),s.z_and_y_bits),
+                      _mm_or_si128(_mm_sll_epi16(_mm_srl_epi16(y,s.y_shift),s.z_bits),
+                                   _mm_srl_epi16(z,s.z_shift)));
+}
+
+// splits 8 UYVY pixels into 16 bit y, u and v lanes
+inline void unpackUYVY128(__m128i d, __m128i & y, __m128i & u, __m128i & v) {
+  y=_mm_srli_epi16(d,8);
+  __m128i u_lo=_mm_and_si128(d,_mm_set1_epi32(0x000000FF));
+  u=_mm_or_si128(u_lo,_mm_slli_epi32(u_lo,16));
+  __m128i v_hi=_mm_and_si128(d,_mm_set1_epi32(0x00FF0000));
+  v=_mm_or_si128(v_hi,_mm_srli_epi32(v_hi,16));
+}
+
+// splits 16 packed 3-channel pixels (48 bytes) into one byte vector per channel, see:
+// https://docs.google.com/presentation/d/1I0-SiHid1hTsv7tjLST2dYW5YF5AJVfs9l4Rg9rvz48/edit#slide=id.g1eefe20b_0_125
+__attribute__((target("sse4.1")))
+inline void unpackPacked3(const uint8_t * src, __m128i & c0, __m128i & c1, __m128i & c2) {
+  const __m128i chunk0 = _mm_loadu_si128((const __m128i*)(src));
+  const __m128i chunk1 = _mm_loadu_si128((const __m128i*)(src + 16));
+  const __m128i chunk2 = _mm_loadu_si128((const __m128i*)(src + 32));
+  c0 = _mm_or_si128(_mm_or_si128(
+         _mm_shuffle_epi8(chunk0, _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 15, 12, 9, 6, 3, 0)),
+         _mm_shuffle_epi8(chunk1, _mm_set_epi8(-1, -1, -1, -1, -1, 14, 11, 8, 5, 2, -1, -1, -1, -1, -1, -1))),
+         _mm_shuffle_epi8(chunk2, _mm_set_epi8(13, 10, 7, 4, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)));
+  c1 = _mm_or_si128(_mm_or_si128(
+         _mm_shuffle_epi8(chunk0, _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 13, 10, 7, 4, 1)),
+         _mm_shuffle_epi8(chunk1, _mm_set_epi8(-1, -1, -1, -1, -1, 15, 12, 9, 6, 3, 0, -1, -1, -1, -1, -1))),
+         _mm_shuffle_epi8(chunk2, _mm_set_epi8(14, 11, 8, 5, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)));
+  c2 = _mm_or_si128(_mm_or_si128(
+         _mm_shuffle_epi8(chunk0, _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 14, 11, 8, 5, 2)),
+         _mm_shuffle_epi8(chunk1, _mm_set_epi8(-1, -1, -1, -1, -1, -1, 13, 10, 7, 4, 1, -1, -1, -1, -1, -1))),
+         _mm_shuffle_epi8(chunk2, _mm_set_epi8(15, 12, 9, 6, 3, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)));
+}
+
+// looks up 16 indices and applies the mask (if any) in-vector
+__attribute__((target("sse4.1")))
+inline void lookup16(const uint16_t * idx, const uint8_t * mask, uint8_t * dst, const lut_mask_t * LUT) {
+  alignas(16) uint8_t val[16];
+  for (int j=0; j<16; j++) {
+    val[j]=LUT[idx[j]];
+  }
+  __m128i v=_mm_load_si128((const __m128i*)val);
+  if (mask!=0) v=_mm_and_si128(v, _mm_loadu_si128((const __m128i*)mask));
+  _mm_storeu_si128((__m128i*)dst, v);
+}
+
+__attribute__((target("sse4.1")))
+int thresholdPacked3SSE41(const uint8_t * src, uint8_t * dst, const uint8_t * mask, int n,
+                          const lut_mask_t * LUT, const LUTIndexer & ix) {
+  SimdShifts s(ix);
+  alignas(16) uint16_t idx[16];
+  int i=0;
+  for (; i+16<=n; i+=16) {
+    __m128i c0,c1,c2;
+    unpackPacked3(src + 3*i, c0, c1, c2);
+    _mm_store_si128((__m128i*)idx, lutIndex128(_mm_cvtepu8_epi16(c0), _mm_cvtepu8_epi16(c1), _mm_cvtepu8_epi16(c2), s));
+    _mm_store_si128((__m128i*)(idx+8), lutIndex128(_mm_cvtepu8_epi16(_mm_srli_si128(c0,8)),
+                                                   _mm_cvtepu8_epi16(_mm_srli_si128(c1,8)),
+                                                   _mm_cvtepu8_epi16(_mm_srli_si128(c2,8)), s));
+    lookup16(idx, mask ? mask + i : 0, dst + i, LUT);
+  }
+  return i;
+}
+
+__attribute__((target("sse4.1")))
+int thresholdUYVYSSE41(const uint8_t * src, uint8_t * dst, const uint8_t * mask, int n,
+                       const lut_mask_t * LUT, const LUTIndexer & ix) {
+  SimdShifts s(ix);
+  alignas(16) uint16_t idx[16];
+  int i=0;
+  for (; i+16<=n; i+=16) {
+    __m128i y,u,v;
+    unpackUYVY128(_mm_loadu_si128((const __m128i*)(src + 2*i)), y, u, v);
+    _mm_store_si128((__m128i*)idx, lutIndex128(y, u, v, s));
+    unpackUYVY128(_mm_loadu_si128((const __m128i*)(src + 2*i + 16)), y, u, v);
+    _mm_store_si128((__m128i*)(idx+8), lutIndex128(y, u, v, s));
+    lookup16(idx, mask ? mask + i : 0, dst + i, LUT);
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+inline __m256i lutIndex256(__m256i x, __m256i y, __m256i z, const SimdShifts & s) {
+  return _mm256_or_si256(_mm256_sll_epi16(_mm256_srl_epi16(x,s.x_shift),s.z_and_y_bits),
+                         _mm256_or_si256(_mm256_sll_epi16(_mm256_srl_epi16(y,s.y_shift),s.z_bits),
+                                         _mm256_srl_epi16(z,s.z_shift)));
+}
+
+__attribute__((target("avx2")))
+inline void unpackUYVY256(__m256i d, __m256i & y, __m256i & u, __m256i & v) {
+  y=_mm256_srli_epi16(d,8);
+  __m256i u_lo=_mm256_and_si256(d,_mm256_set1_epi32(0x000000FF));
+  u=_mm256_or_si256(u_lo,_mm256_slli_epi32(u_lo,16));
+  __m256i v_hi=_mm256_and_si256(d,_mm256_set1_epi32(0x00FF0000));
+  v=_mm256_or_si256(v_hi,_mm256_srli_epi32(v_hi,16));
+}
+
+// Gathers are not used below AVX-512: on several of the cpus in use an
+// AVX2 gather of 8 bytes is slower than 8 scalar loads from the
+// (mostly cached) LUT.
+__attribute__((target("avx2")))
+int thresholdPacked3AVX2(const uint8_t * src, uint8_t * dst, const uint8_t * mask, int n,
+                         const lut_mask_t * LUT, const LUTIndexer & ix) {
+  SimdShifts s(ix);
+  alignas(32) uint16_t idx[16];
+  int i=0;
+  for (; i+16<=n; i+=16) {
+    __m128i c0,c1,c2;
+    unpackPacked3(src + 3*i, c0, c1, c2);
+    _mm256_store_si256((__m256i*)idx, lutIndex256(_mm256_cvtepu8_epi16(c0), _mm256_cvtepu8_epi16(c1), _mm256_cvtepu8_epi16(c2), s));
+    lookup16(idx, mask ? mask + i : 0, dst + i, LUT);
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+int thresholdUYVYAVX2(const uint8_t * src, uint8_t * dst, const uint8_t * mask, int n,
+                      const lut_mask_t * LUT, const LUTIndexer & ix) {
+  SimdShifts s(ix);
+  alignas(32) uint16_t idx[16];
+  int i=0;
+  for (; i+16<=n; i+=16) {
+    __m256i y,u,v;
+    unpackUYVY256(_mm256_loadu_si256((const __m256i*)(src + 2*i)), y, u, v);
+    _mm256_store_si256((__m256i*)idx, lutIndex256(y, u, v, s));
+    lookup16(idx, mask ? mask + i : 0, dst + i, LUT);
+  }
+  return i;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline __m512i lutIndex512(__m512i x, __m512i y, __m512i z, const SimdShifts & s) {
+  return _mm512_or_si512(_mm512_sll_epi16(_mm512_srl_epi16(x,s.x_shift),s.z_and_y_bits),
+                         _mm512_or_si512(_mm512_sll_epi16(_mm512_srl_epi16(y,s.y_shift),s.z_bits),
+                                         _mm512_srl_epi16(z,s.z_shift)));
+}
+
+// Looks up 32 indices with two 16-wide gathers and applies the mask (if any) in-vector.
+// The gathers read 4 bytes per entry; this stays inside the table because
+// LUT3D allocates twice the space its index bits can address.
+__attribute__((target("avx512f,avx512bw")))
+inline void lookup32AVX512(__m512i idx, const uint8_t * mask, uint8_t * dst, const lut_mask_t * LUT) {
+  __m512i lo=_mm512_cvtepu16_epi32(_mm512_castsi512_si256(idx));
+  __m512i hi=_mm512_cvtepu16_epi32(_mm512_extracti64x4_epi64(idx,1));
+  __m128i val_lo=_mm512_cvtepi32_epi8(_mm512_i32gather_epi32(lo, (const void*)LUT, 1));
+  __m128i val_hi=_mm512_cvtepi32_epi8(_mm512_i32gather_epi32(hi, (const void*)LUT, 1));
+  __m256i val=_mm256_inserti128_si256(_mm256_castsi128_si256(val_lo), val_hi, 1);
+  if (mask!=0) val=_mm256_and_si256(val, _mm256_loadu_si256((const __m256i*)mask));
+  _mm256_storeu_si256((__m256i*)dst, val);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+int thresholdPacked3AVX512(const uint8_t * src, uint8_t * dst, const uint8_t * mask, int n,
+                           const lut_mask_t * LUT, const LUTIndexer & ix) {
+  SimdShifts s(ix);
+  int i=0;
+  for (; i+32<=n; i+=32) {
+    __m128i a0,a1,a2,b0,b1,b2;
+    unpackPacked3(src + 3*i, a0, a1, a2);
+    unpackPacked3(src + 3*i + 48, b0, b1, b2);
+    __m512i c0=_mm512_cvtepu8_epi16(_mm256_inserti128_si256(_mm256_castsi128_si256(a0), b0, 1));
+    __m512i c1=_mm512_cvtepu8_epi16(_mm256_inserti128_si256(_mm256_castsi128_si256(a1), b1, 1));
+    __m512i c2=_mm512_cvtepu8_epi16(_mm256_inserti128_si256(_mm256_castsi128_si256(a2), b2, 1));
+    lookup32AVX512(lutIndex512(c0, c1, c2, s), mask ? mask + i : 0, dst + i, LUT);
+  }
+  return i;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+int thresholdUYVYAVX512(const uint8_t * src, uint8_t * dst, const uint8_t * mask, int n,
+                        const lut_mask_t * LUT, const LUTIndexer & ix) {
+  SimdShifts s(ix);
+  int i=0;
+  for (; i+32<=n; i+=32) {
+    __m512i d=_mm512_loadu_si512((const void*)(src + 2*i));
+    __m512i y=_mm512_srli_epi16(d,8);
+    __m512i u_lo=_mm512_and_si512(d,_mm512_set1_epi32(0x000000FF));
+    __m512i u=_mm512_or_si512(u_lo,_mm512_slli_epi32(u_lo,16));
+    __m512i v_hi=_mm512_and_si512(d,_mm512_set1_epi32(0x00FF0000));
+    __m512i v=_mm512_or_si512(v_hi,_mm512_srli_epi32(v_hi,16));
+    lookup32AVX512(lutIndex512(y, u, v, s), mask ? mask + i : 0, dst + i, LUT);
+  }
+  return i;
+}
+
+#endif
+
+ThresholdKernel packed3Kernel(CMVisionThreshold::SimdLevel level) {
+#ifdef CMV_THRESHOLD_X86
+  switch (level) {
+    case CMVisionThreshold::SimdAVX512: return thresholdPacked3AVX512;
+    case CMVisionThreshold::SimdAVX2: return thresholdPacked3AVX2;
+    case CMVisionThreshold::SimdSSE41: return thresholdPacked3SSE41;
+    default: break;
+  }
+#else
+  (void)level;
+#endif
+  return 0;
+}
+
+ThresholdKernel uyvyKernel(CMVisionThreshold::SimdLevel level) {
+#ifdef CMV_THRESHOLD_X86
+  switch (level) {
+    case CMVisionThreshold::SimdAVX512: return thresholdUYVYAVX512;
+    case CMVisionThreshold::SimdAVX2: return thresholdUYVYAVX2;
+    case CMVisionThreshold::SimdSSE41: return thresholdUYVYSSE41;
+    default: break;
+  }
+#else
+  (void)level;
+#endif
+  return 0;
+}
+
+// thresholds pixels [begin,end) of a packed 3-channel image into dst, which holds just those pixels
+void thresholdPacked3Range(const uint8_t * src, uint8_t * dst, const uint8_t * mask, int begin, int end,
+                           const lut_mask_t * LUT, const LUTIndexer & ix, ThresholdKernel kernel) {
+  src += 3*begin;
+  if (mask!=0) mask += begin;
+  int n=end-begin;
+  int done=0;
+  if (kernel!=0 && ix.total_bits <= 16) {
+    done=kernel(src, dst, mask, n, LUT, ix);
+  }
+  thresholdPacked3Scalar(src, dst, mask, done, n, LUT, ix);
+}
+
+// same for UYVY, where a range may start in the middle of a macro pixel
+void thresholdUYVYRange(const uint8_t * src, uint8_t * dst, const uint8_t * mask, int begin, int end,
+                        const lut_mask_t * LUT, const LUTIndexer & ix, ThresholdKernel kernel) {
+  if ((begin & 1) && begin < end) {
+    const uint8_t * p=src + 4*(begin >> 1);
+    lut_mask_t v = LUT[ix.index(p[3],p[0],p[2])];
+    *dst++ = (mask!=0) ? (mask[begin] & v) : v;
+    begin++;
+  }
+  src += 2*begin;
+  if (mask!=0) mask += begin;
+  int n=end-begin;
+  int done=0;
+  if (kernel!=0 && ix.total_bits <= 16) {
+    done=kernel(src, dst, mask, n, LUT, ix);
+  }
+  thresholdUYVYScalar(src, dst, mask, done, n, LUT, ix);
+}
+
+// Thresholds pixels [x_begin,x_end) of row y of an RGGB bayer mosaic into
+// dst_row (indexed by x, like the optional mask_row).
+// Same sampling as Conversions::bayer2rgb: each pixel takes its color
+// from the 2x2 window starting at it, so no RGB image is ever built.
+void thresholdBayerSpan(const uint8_t * src, int width, int height, int y, int x_begin, int x_end,
+                        uint8_t * dst_row, const uint8_t * mask_row, const lut_mask_t * LUT, const LUTIndexer & ix) {
+  int y0 = (y < height-1) ? y : y-1;
+  const uint8_t * row_a = src + y0 * width;
+  const uint8_t * row_rg = (y0 & 1) ? row_a + width : row_a;
+  const uint8_t * row_gb = (y0 & 1) ? row_a : row_a + width;
+
+  int x=x_begin;
+  // pairs of pixels, starting at an even one: the window of an even pixel
+  // has red at its left, the window of an odd pixel has red at its right
+  if ((x & 1) && x < x_end) {
+    rgb p = Conversions::bayer2rgb(src, width, height, x, y);
+    lut_mask_t v = LUT[ix.index(p.r,p.g,p.b)];
+    dst_row[x] = (mask_row!=0) ? (mask_row[x] & v) : v;
+    x++;
+  }
+  for (; x+1<x_end && x<width-2; x+=2) {
+    int r0 = row_rg[x];
+    int g0 = (row_rg[x+1] + row_gb[x]) >> 1;
+    int b0 = row_gb[x+1];
+    int r1 = row_rg[x+2];
+    int g1 = (row_rg[x+1] + row_gb[x+2]) >> 1;
+    int b1 = b0;
+    lut_mask_t v0 = LUT[ix.index(r0,g0,b0)];
+    lut_mask_t v1 = LUT[ix.index(r1,g1,b1)];
+    if (mask_row!=0) {
+      v0 &= mask_row[x];
+      v1 &= mask_row[x+1];
+    }
+    dst_row[x] = v0;
+    dst_row[x+1] = v1;
+  }
+  // remaining pixels, the last column may have to use the window to its left
+  for (; x<x_end; x++) {
+    rgb p = Conversions::bayer2rgb(src, width, height, x, y);
+    lut_mask_t v = LUT[ix.index(p.r,p.g,p.b)];
+    dst_row[x] = (mask_row!=0) ? (mask_row[x] & v) : v;
+  }
+}
+
+// calls f(y, x_begin, x_end, dst_row) for the unmasked pixels of every row in
+// [row_begin,row_end), where dst_row is the row of target (which starts at row_begin)
+template <class F>
+void forEachSpan(uint8_t * target, int width, const ImageMaskSpans * spans, int row_begin, int row_end,
+                 bool clear_masked, F f) {
+  for (int y=row_begin; y<row_end; y++) {
+    uint8_t * dst_row = target + (y - row_begin) * width;
+    if (spans==0) {
+      f(y, 0, width, dst_row);
+      continue;
+    }
+    int x=0;
+    for (const MaskSpan * span=spans->rowBegin(y); span!=spans->rowEnd(y); span++) {
+      if (clear_masked) memset(dst_row + x, 0, span->x_begin - x);
+      f(y, span->x_begin, span->x_end, dst_row);
+      x=span->x_end;
+    }
+    if (clear_masked) memset(dst_row + x, 0, width - x);
+  }
+}
+
+}
+
+CMVisionThreshold::SimdLevel CMVisionThreshold::simd_level=CMVisionThreshold::detectSimdLevel();
+
 CMVisionThreshold::CMVisionThreshold()
 {
 }
@@ -33,6 +443,34 @@ CMVisionThreshold::~CMVisionThreshold()
 {
 }
 
+CMVisionThreshold::SimdLevel CMVisionThreshold::detectSimdLevel() {
+#ifdef CMV_THRESHOLD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return SimdAVX512;
+  if (__builtin_cpu_supports("avx2")) return SimdAVX2;
+  if (__builtin_cpu_supports("sse4.1")) return SimdSSE41;
+#endif
+  return SimdNone;
+}
+
+CMVisionThreshold::SimdLevel CMVisionThreshold::getSimdLevel() {
+  return simd_level;
+}
+
+void CMVisionThreshold::setSimdLevel(SimdLevel level) {
+  SimdLevel supported=detectSimdLevel();
+  simd_level = (level > supported) ? supported : level;
+}
+
+const char * CMVisionThreshold::simdLevelToString(SimdLevel level) {
+  switch (level) {
+    case SimdAVX512: return "AVX-512";
+    case SimdAVX2: return "AVX2";
+    case SimdSSE41: return "SSE4.1";
+    default: return "none";
+  }
+}
+
 bool CMVisionThreshold::thresholdImageYUV422_UYVY(Image<raw8> * target, const RawImage * source, YUVLUT * lut, const ImageInterface* mask) {
   if (source->getColorFormat()!=COLOR_YUV422_UYVY) {
     //TODO add YUV444 and maybe even 411 mode
@@ -40,32 +478,19 @@ bool CMVisionThreshold::thresholdImageYUV422_UYVY(Image<raw8> * target, const Ra
     return false;
   }
 
-  register lut_mask_t * LUT = lut->getTable();
-
-  register unsigned int          target_size    = target->getNumPixels();
-  register uyvy *       source_pointer = (uyvy*)(source->getData());
-  register raw8 *      target_pointer = target->getPixelData();
-  register unsigned char *      mask_pointer = mask->getData();
-
   if (target->getNumPixels() != source->getNumPixels()) {
     fprintf(stderr, "CMVision YUV422_UYVY thresholding: source (num=%d  w=%d  h=%d) and target (num=%d w=%d h=%d) pixel counts do not match!\n", source->getNumPixels(),source->getWidth(),source->getHeight(), target->getNumPixels(),target->getWidth(),target->getHeight());
     return false;
   }
 
+  int target_size = target->getNumPixels();
+  const uint8_t * source_pointer = source->getData();
+  auto * target_pointer = (uint8_t*) target->getPixelData();
+  const uint8_t * mask_pointer = mask->getData();
+
   lut->lock();
-  int X_SHIFT=lut->X_SHIFT;
-  int Y_SHIFT=lut->Y_SHIFT;
-  int Z_SHIFT=lut->Z_SHIFT;
-  int Z_AND_Y_BITS=lut->Z_AND_Y_BITS;
-  int Z_BITS = lut->Z_BITS;
-  uyvy p;
-  for (unsigned int i=0;i<target_size;i+=2) {
-    p=source_pointer[(i >> 0x01)];
-    register int B=((p.u >> Y_SHIFT) << Z_BITS);
-    register int C=(p.v >> Z_SHIFT);
-    target_pointer[i] =  mask_pointer[i] & LUT[(((p.y1 >> X_SHIFT) << Z_AND_Y_BITS) | B | C)];
-    target_pointer[i+1] =  mask_pointer[i+1] & LUT[(((p.y2 >> X_SHIFT) << Z_AND_Y_BITS) | B | C)];
-  }
+  thresholdUYVYRange(source_pointer, target_pointer, mask_pointer, 0, target_size,
+                     lut->getTable(), LUTIndexer(lut), uyvyKernel(simd_level));
   lut->unlock();
   return true;
 }
@@ -76,29 +501,19 @@ bool CMVisionThreshold::thresholdImageYUV444(Image<raw8> * target, const ImageIn
     return false;
   }
 
-  register lut_mask_t * LUT = lut->getTable();
-
-  register unsigned int          target_size    = target->getNumPixels();
-  register yuv  *                source_pointer = (yuv*)(source->getData());
-  register raw8 *                target_pointer = target->getPixelData();
-  register unsigned char *       mask_pointer = mask->getData();
-
   if (target->getNumPixels() != source->getNumPixels()) {
      fprintf(stderr, "CMVision YUV444 thresholding: source (num=%d  w=%d  h=%d) and target (num=%d w=%d h=%d) pixel counts do not match!\n", source->getNumPixels(),source->getWidth(),source->getHeight(), target->getNumPixels(),target->getWidth(),target->getHeight());
     return false;
   }
 
+  int target_size = target->getNumPixels();
+  const uint8_t * source_pointer = source->getData();
+  auto * target_pointer = (uint8_t*) target->getPixelData();
+  const uint8_t * mask_pointer = mask->getData();
+
   lut->lock();
-  int X_SHIFT=lut->X_SHIFT;
-  int Y_SHIFT=lut->Y_SHIFT;
-  int Z_SHIFT=lut->Z_SHIFT;
-  int Z_AND_Y_BITS=lut->Z_AND_Y_BITS;
-  int Z_BITS = lut->Z_BITS;
-  yuv p;
-  for (unsigned int i=0;i<target_size;i++) {
-    p=source_pointer[i];
-    target_pointer[i] =  mask_pointer[i] & LUT[(((p.y >> X_SHIFT) << Z_AND_Y_BITS) | ((p.u >> Y_SHIFT) << Z_BITS) | (p.v >> Z_SHIFT))];
-  }
+  thresholdPacked3Range(source_pointer, target_pointer, mask_pointer, 0, target_size,
+                        lut->getTable(), LUTIndexer(lut), packed3Kernel(simd_level));
   lut->unlock();
 
   return true;
@@ -112,81 +527,110 @@ bool CMVisionThreshold::thresholdImageRGB(Image<raw8> * target, const ImageInter
     return false;
   }
 
-  register lut_mask_t * LUT = lut->getTable();
-  int source_size    = source->getNumPixels();
-  const rgb * source_pointer = (const rgb*)(source->getData());
+  if (target->getNumPixels() != source->getNumPixels()) {
+    fprintf(stderr, "CMVision RGB thresholding: source (num=%d  w=%d  h=%d) and target (num=%d w=%d h=%d) pixel counts do not match!\n", source->getNumPixels(),source->getWidth(),source->getHeight(), target->getNumPixels(),target->getWidth(),target->getHeight());
+    return false;
+  }
+
+  int source_size = source->getNumPixels();
+  const uint8_t * source_pointer = source->getData();
   auto * target_pointer = (uint8_t*) target->getPixelData();
-  auto * mask_pointer = mask->getData();
+  const uint8_t * mask_pointer = mask->getData();
+
+  thresholdPacked3Range(source_pointer, target_pointer, mask_pointer, 0, source_size,
+                        lut->getTable(), LUTIndexer(lut), packed3Kernel(simd_level));
+
+  return true;
+}
+
+bool CMVisionThreshold::thresholdImageRAW8(Image<raw8> * target, const RawImage * source, RGBLUT * lut, const ImageInterface* mask) {
+  if (source->getColorFormat()!=COLOR_RAW8) {
+    fprintf(stderr,"CMVision RAW8 thresholding assumes RAW8 as input, but found %s\n", Colors::colorFormatToString(source->getColorFormat()).c_str());
+    return false;
+  }
 
   if (target->getNumPixels() != source->getNumPixels()) {
-    fprintf(stderr, "CMVision RGB thresholding: source (num=%d  w=%d  h=%d) and target (num=%d w=%d h=%d) pixel counts do not match!\n", source->getNumPixels(),source->getWidth(),source->getHeight(), target->getNumPixels(),target->getWidth(),target->getHeight());
+    fprintf(stderr, "CMVision RAW8 thresholding: source (num=%d  w=%d  h=%d) and target (num=%d w=%d h=%d) pixel counts do not match!\n", source->getNumPixels(),source->getWidth(),source->getHeight(), target->getNumPixels(),target->getWidth(),target->getHeight());
     return false;
   }
 
-  int X_SHIFT=lut->X_SHIFT;
-  int Y_SHIFT=lut->Y_SHIFT;
-  int Z_SHIFT=lut->Z_SHIFT;
-  int Z_AND_Y_BITS=lut->Z_AND_Y_BITS;
-  int Z_BITS = lut->Z_BITS;
-
-#ifdef __AVX2__
-  // unpacking from: https://docs.google.com/presentation/d/1I0-SiHid1hTsv7tjLST2dYW5YF5AJVfs9l4Rg9rvz48/edit#slide=id.g1eefe20b_0_125
-  __m128i ssse3_red_indeces_0 = _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 15, 12, 9, 6, 3, 0);
-  __m128i ssse3_red_indeces_1 = _mm_set_epi8(-1, -1, -1, -1, -1, 14, 11, 8, 5, 2, -1, -1, -1, -1, -1, -1);
-  __m128i ssse3_red_indeces_2 = _mm_set_epi8(13, 10, 7, 4, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
-  __m128i ssse3_green_indeces_0 = _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 13, 10, 7, 4, 1);
-  __m128i ssse3_green_indeces_1 = _mm_set_epi8(-1, -1, -1, -1, -1, 15, 12, 9, 6, 3, 0, -1, -1, -1, -1, -1);
-  __m128i ssse3_green_indeces_2 = _mm_set_epi8(14, 11, 8, 5, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
-  __m128i ssse3_blue_indeces_0 = _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 14, 11, 8, 5, 2);
-  __m128i ssse3_blue_indeces_1 = _mm_set_epi8(-1, -1, -1, -1, -1, -1, 13, 10, 7, 4, 1, -1, -1, -1, -1, -1);
-  __m128i ssse3_blue_indeces_2 = _mm_set_epi8(15, 12, 9, 6, 3, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
-
-  uint16_t idx[16];
-  const rgb* p=&source_pointer[0];
-  const uint8_t* source_pixel = (const uint8_t*)p;
-
-  for (int i=0; i<source_size; i+=16) {
-
-    // crazy RGB unpacking
-    const __m128i chunk0 = _mm_loadu_si128((const __m128i*)(source_pixel));
-    const __m128i chunk1 = _mm_loadu_si128((const __m128i*)(source_pixel + 16));
-    const __m128i chunk2 = _mm_loadu_si128((const __m128i*)(source_pixel + 32));
-    source_pixel += 48;
-
-    const __m128i red = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(chunk0, ssse3_red_indeces_0),
-                                                  _mm_shuffle_epi8(chunk1, ssse3_red_indeces_1)), _mm_shuffle_epi8(chunk2, ssse3_red_indeces_2));
-    const __m128i green = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(chunk0, ssse3_green_indeces_0),
-                                                    _mm_shuffle_epi8(chunk1, ssse3_green_indeces_1)), _mm_shuffle_epi8(chunk2, ssse3_green_indeces_2));
-    const __m128i blue = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(chunk0, ssse3_blue_indeces_0),
-                                                   _mm_shuffle_epi8(chunk1, ssse3_blue_indeces_1)), _mm_shuffle_epi8(chunk2, ssse3_blue_indeces_2));
-
-    // widen pixel values to 16bit
-    __m256i r = _mm256_cvtepu8_epi16(red);
-    __m256i b = _mm256_cvtepu8_epi16(blue);
-    __m256i g = _mm256_cvtepu8_epi16(green);
-
-    // do the original shifts on 16 values in parallel
-    __m256i rs = _mm256_slli_epi16(_mm256_srli_epi16(r, X_SHIFT), Z_AND_Y_BITS);
-    __m256i gs = _mm256_slli_epi16(_mm256_srli_epi16(g, Y_SHIFT), Z_BITS);
-    __m256i bs = _mm256_srli_epi16(b, Z_SHIFT);
-
-    // construct LUT indices (ORing)
-    __m256i result = _mm256_or_si256(rs, _mm256_or_si256(gs, bs));
-
-    _mm256_storeu_si256((__m256i*)idx, result);
-
-#pragma GCC unroll 16
-    for(int j=0; j<16; j++) {
-      target_pointer[i+j] = mask_pointer[i] & LUT[idx[j]];
-    }
+  int width = source->getWidth();
+  int height = source->getHeight();
+  if (width < 2 || height < 2) {
+    fprintf(stderr, "CMVision RAW8 thresholding: image (w=%d h=%d) is smaller than a bayer cell\n", width, height);
+    return false;
   }
-#else
-  #pragma GCC unroll 4
-  for (int i=0; i<source_size; i++) {
-    rgb p=source_pointer[i];
-    target_pointer[i] = mask_pointer[i] & LUT[(((p.r >> X_SHIFT) << Z_AND_Y_BITS) | ((p.g >> Y_SHIFT) << Z_BITS) | (p.b >> Z_SHIFT))];
+
+  const uint8_t * source_pointer = source->getData();
+  auto * target_pointer = (uint8_t*) target->getPixelData();
+  const uint8_t * mask_pointer = mask->getData();
+  const lut_mask_t * LUT = lut->getTable();
+  LUTIndexer ix(lut);
+  for (int y=0; y<height; y++) {
+    thresholdBayerSpan(source_pointer, width, height, y, 0, width,
+                       target_pointer + y * width, mask_pointer + y * width, LUT, ix);
   }
-#endif
 
   return true;
 }
+
+bool CMVisionThreshold::thresholdRows(uint8_t * target, const RawImage * source, YUVLUT * lut, const ImageMaskSpans * spans,
+                                      int row_begin, int row_end, bool clear_masked) {
+  int width = source->getWidth();
+  int height = source->getHeight();
+  if (row_begin < 0 || row_end > height || row_begin > row_end) {
+    fprintf(stderr, "CMVision thresholding: rows [%d,%d) are outside of the image (h=%d)\n", row_begin, row_end, height);
+    return false;
+  }
+  if (spans != 0 && (spans->getWidth() != width || spans->getHeight() != height)) {
+    fprintf(stderr, "CMVision thresholding: mask (w=%d h=%d) and image (w=%d h=%d) sizes do not match!\n",
+            spans->getWidth(), spans->getHeight(), width, height);
+    return false;
+  }
+
+  const uint8_t * source_pointer = source->getData();
+
+  ColorFormat format = source->getColorFormat();
+  if (format == COLOR_YUV422_UYVY || format == COLOR_YUV444) {
+    bool uyvy = (format == COLOR_YUV422_UYVY);
+    lut->lock();
+    const lut_mask_t * LUT = lut->getTable();
+    LUTIndexer ix(lut);
+    ThresholdKernel kernel = uyvy ? uyvyKernel(simd_level) : packed3Kernel(simd_level);
+    forEachSpan(target, width, spans, row_begin, row_end, clear_masked,
+                [&](int y, int x_begin, int x_end, uint8_t * dst_row) {
+      if (uyvy) {
+        thresholdUYVYRange(source_pointer, dst_row + x_begin, 0, y*width + x_begin, y*width + x_end, LUT, ix, kernel);
+      } else {
+        thresholdPacked3Range(source_pointer, dst_row + x_begin, 0, y*width + x_begin, y*width + x_end, LUT, ix, kernel);
+      }
+    });
+    lut->unlock();
+  } else if (format == COLOR_RGB8 || format == COLOR_RAW8) {
+    auto * rgblut = (RGBLUT *) lut->getDerivedLUT(CSPACE_RGB);
+    if (rgblut == nullptr) {
+      printf("WARNING: No RGB LUT has been defined. You need to create a derived RGB LUT by calling e.g. \"lut_yuv->addDerivedLUT(new RGBLUT(5,5,5,\"\"))\" in the stack constructor!\n");
+      return false;
+    }
+    if (format == COLOR_RAW8 && (width < 2 || height < 2)) {
+      fprintf(stderr, "CMVision RAW8 thresholding: image (w=%d h=%d) is smaller than a bayer cell\n", width, height);
+      return false;
+    }
+    const lut_mask_t * LUT = rgblut->getTable();
+    LUTIndexer ix(rgblut);
+    ThresholdKernel kernel = packed3Kernel(simd_level);
+    forEachSpan(target, width, spans, row_begin, row_end, clear_masked,
+                [&](int y, int x_begin, int x_end, uint8_t * dst_row) {
+      if (format == COLOR_RAW8) {
+        thresholdBayerSpan(source_pointer, width, height, y, x_begin, x_end, dst_row, 0, LUT, ix);
+      } else {
+        thresholdPacked3Range(source_pointer, dst_row + x_begin, 0, y*width + x_begin, y*width + x_end, LUT, ix, kernel);
+      }
+    });
+  } else {
+    fprintf(stderr, "ColorThresholding needs YUV422, YUV444, RGB8, or RAW8 as input image, but found: %s\n",
+            Colors::colorFormatToString(format).c_str());
+    return false;
+  }
+  return true;
+}
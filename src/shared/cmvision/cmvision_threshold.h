@@ -24,6 +24,7 @@
 
 #include "lut3d.h"
 #include "image_interface.h"
+#include "image_mask_spans.h"
 #include "image.h"
 #include "colors.h"
 #include "timer.h"
@@ -33,14 +34,41 @@
           Some code restructuring, and data structure changes: Stefan Zickler 2008
 */
 class CMVisionThreshold{
+public:
+  /// vector instruction sets the thresholding kernels can use,
+  /// selected at runtime from what the cpu supports
+  enum SimdLevel {
+    SimdNone=0,
+    SimdSSE41,
+    SimdAVX2,
+    SimdAVX512
+  };
+protected:
+  static SimdLevel simd_level;
 public:
     CMVisionThreshold();
 
     ~CMVisionThreshold();
 
+  static SimdLevel detectSimdLevel();
+  static SimdLevel getSimdLevel();
+  /// limits the kernels to \p level (e.g. for benchmarking); levels the cpu does not support are ignored
+  static void setSimdLevel(SimdLevel level);
+  static const char * simdLevelToString(SimdLevel level);
+
   static bool thresholdImageYUV422_UYVY(Image<raw8> * target, const RawImage * source, YUVLUT * lut, const ImageInterface* mask);
   static bool thresholdImageYUV444(Image<raw8> * target, const ImageInterface * source, YUVLUT * lut, const ImageInterface* mask);
   static bool thresholdImageRGB(Image<raw8> * target, const ImageInterface * source, RGBLUT * lut, const ImageInterface* mask);
+  /// thresholds an RGGB bayer mosaic directly, without demosaicing it first (see Conversions::bayer2rgb)
+  static bool thresholdImageRAW8(Image<raw8> * target, const RawImage * source, RGBLUT * lut, const ImageInterface* mask);
+
+  /// thresholds rows [row_begin,row_end) of \p source in any of the formats above into
+  /// \p target, which holds just those rows. RGB8 and RAW8 images use the derived RGB
+  /// LUT of \p lut. The result is the same as the matching part of a full-image threshold.
+  /// Only the unmasked pixels given by \p spans (all pixels if null) are looked up; the
+  /// masked ones are set to 0, or left untouched if \p clear_masked is false.
+  static bool thresholdRows(uint8_t * target, const RawImage * source, YUVLUT * lut, const ImageMaskSpans * spans,
+                            int row_begin, int row_end, bool clear_masked=true);
 };
 
 #endif
@@ -33,6 +33,19 @@ CameraParameters::CameraParameters(int camera_index_, RoboCupField * field_) :
       new AdditionalCalibrationInformation(camera_index_, field_);
 
   q_rotate180 = Quaternion<double>(0, 0, 1.0,0);
+
+  snapshot_notifier.addItem(focal_length);
+  snapshot_notifier.addItem(principal_point_x);
+  snapshot_notifier.addItem(principal_point_y);
+  snapshot_notifier.addItem(distortion);
+  snapshot_notifier.addItem(q0);
+  snapshot_notifier.addItem(q1);
+  snapshot_notifier.addItem(q2);
+  snapshot_notifier.addItem(q3);
+  snapshot_notifier.addItem(tx);
+  snapshot_notifier.addItem(ty);
+  snapshot_notifier.addItem(tz);
+  snapshot_notifier.setChanged(true);
 }
 
 CameraParameters::~CameraParameters() {
@@ -105,32 +118,15 @@ void CameraParameters::addSettingsToList(VarList& list) {
 }
 
 double CameraParameters::radialDistortion(double ru) const {
-  if ((distortion->getDouble())<=DBL_MIN)
-    return ru;
-  double rd = 0;
-  double a = distortion->getDouble();
-  double b = -9.0*a*a*ru + a*sqrt(a*(12.0 + 81.0*a*ru*ru));
-  b = (b < 0.0) ? (-pow(b, 1.0 / 3.0)) : pow(b, 1.0 / 3.0);
-  rd = pow(2.0 / 3.0, 1.0 / 3.0) / b -
-      b / (pow(2.0 * 3.0 * 3.0, 1.0 / 3.0) * a);
-  return rd;
+  return Snapshot::radialDistortion(ru, distortion->getDouble());
 }
 
 double CameraParameters::radialDistortion(double ru, double dist) const {
-  if (dist<=DBL_MIN)
-    return ru;
-  double rd = 0;
-  double a = dist;
-  double b = -9.0*a*a*ru + a*sqrt(a*(12.0 + 81.0*a*ru*ru));
-  b = (b < 0.0) ? (-pow(b, 1.0 / 3.0)) : pow(b, 1.0 / 3.0);
-  rd = pow(2.0 / 3.0, 1.0 / 3.0) / b -
-      b / (pow(2.0 * 3.0 * 3.0, 1.0 / 3.0) * a);
-  return rd;
+  return Snapshot::radialDistortion(ru, dist);
 }
 
 double CameraParameters::radialDistortionInv(double rd) const {
-  double ru = rd*(1.0+rd*rd*distortion->getDouble());
-  return ru;
+  return Snapshot::radialDistortionInv(rd, distortion->getDouble());
 }
 
 void CameraParameters::radialDistortionInv(
@@ -158,28 +154,7 @@ void CameraParameters::radialDistortion(
 void CameraParameters::field2image(
     const GVector::vector3d<double> &p_f,
     GVector::vector2d<double> &p_i) const {
-  Quaternion<double> q_field2cam = Quaternion<double>(
-      q0->getDouble(),q1->getDouble(),q2->getDouble(),q3->getDouble());
-  q_field2cam.norm();
-  GVector::vector3d<double> translation = GVector::vector3d<double>(
-      tx->getDouble(),ty->getDouble(),tz->getDouble());
-
-  // First transform the point from the field into the coordinate system of the
-  // camera
-  GVector::vector3d<double> p_c =
-      q_field2cam.rotateVectorByQuaternion(p_f) + translation;
-  GVector::vector2d<double> p_un =
-      GVector::vector2d<double>(p_c.x/p_c.z, p_c.y/p_c.z);
-
-  // Apply distortion
-  GVector::vector2d<double> p_d;
-  radialDistortion(p_un,p_d);
-
-  // Then project from the camera coordinate system onto the image plane using
-  // the instrinsic parameters
-  p_i = focal_length->getDouble() * p_d +
-      GVector::vector2d<double>(principal_point_x->getDouble(),
-                                principal_point_y->getDouble());
+  Snapshot(*this).field2image(p_f,p_i);
 }
 
 void CameraParameters::field2image(
@@ -220,40 +195,102 @@ void CameraParameters::field2image(
 void CameraParameters::image2field(
     GVector::vector3d<double> &p_f, const GVector::vector2d<double> &p_i,
     double z) const {
+  Snapshot(*this).image2field(p_f,p_i,z);
+}
+
+std::shared_ptr<const CameraParameters::Snapshot>
+CameraParameters::getSnapshot() const {
+  if (snapshot_notifier.hasChangedNoReset()) {
+    std::lock_guard<std::mutex> guard(snapshot_mutex);
+    if (snapshot_notifier.hasChanged()) {
+      std::atomic_store(&snapshot,
+          std::shared_ptr<const Snapshot>(new Snapshot(*this)));
+    }
+  }
+  return std::atomic_load(&snapshot);
+}
+
+CameraParameters::Snapshot::Snapshot(const CameraParameters& params) {
+  focal_length = params.focal_length->getDouble();
+  principal_point_x = params.principal_point_x->getDouble();
+  principal_point_y = params.principal_point_y->getDouble();
+  distortion = params.distortion->getDouble();
+  q_field2cam = Quaternion<double>(
+      params.q0->getDouble(),params.q1->getDouble(),
+      params.q2->getDouble(),params.q3->getDouble());
+  q_field2cam.norm();
+  translation = GVector::vector3d<double>(
+      params.tx->getDouble(),params.ty->getDouble(),params.tz->getDouble());
+
+  q_field2cam_inv = q_field2cam;
+  q_field2cam_inv.invert();
+  camera_in_field = q_field2cam_inv.rotateVectorByQuaternion(
+      GVector::vector3d<double>(0,0,0) - translation);
+}
+
+double CameraParameters::Snapshot::radialDistortion(double ru, double dist) {
+  if (dist<=DBL_MIN)
+    return ru;
+  double rd = 0;
+  double a = dist;
+  double b = -9.0*a*a*ru + a*sqrt(a*(12.0 + 81.0*a*ru*ru));
+  b = (b < 0.0) ? (-pow(b, 1.0 / 3.0)) : pow(b, 1.0 / 3.0);
+  rd = pow(2.0 / 3.0, 1.0 / 3.0) / b -
+      b / (pow(2.0 * 3.0 * 3.0, 1.0 / 3.0) * a);
+  return rd;
+}
+
+double CameraParameters::Snapshot::radialDistortionInv(double rd, double dist) {
+  double ru = rd*(1.0+rd*rd*dist);
+  return ru;
+}
+
+void CameraParameters::Snapshot::field2image(
+    const GVector::vector3d<double> &p_f,
+    GVector::vector2d<double> &p_i) const {
+  // First transform the point from the field into the coordinate system of the
+  // camera
+  GVector::vector3d<double> p_c =
+      q_field2cam.rotateVectorByQuaternion(p_f) + translation;
+  GVector::vector2d<double> p_un =
+      GVector::vector2d<double>(p_c.x/p_c.z, p_c.y/p_c.z);
+
+  // Apply distortion
+  GVector::vector2d<double> p_d = p_un;
+  p_d = p_d.norm(radialDistortion(p_un.length(), distortion));
+
+  // Then project from the camera coordinate system onto the image plane using
+  // the instrinsic parameters
+  p_i = focal_length * p_d +
+      GVector::vector2d<double>(principal_point_x, principal_point_y);
+}
+
+void CameraParameters::Snapshot::image2field(
+    GVector::vector3d<double> &p_f, const GVector::vector2d<double> &p_i,
+    double z) const {
   // Undo scaling and offset
   GVector::vector2d<double> p_d(
-      (p_i.x - principal_point_x->getDouble()) / focal_length->getDouble(),
-      (p_i.y - principal_point_y->getDouble()) / focal_length->getDouble());
+      (p_i.x - principal_point_x) / focal_length,
+      (p_i.y - principal_point_y) / focal_length);
 
   // Compensate for distortion (undistort)
-  GVector::vector2d<double> p_un;
-  radialDistortionInv(p_un,p_d);
+  GVector::vector2d<double> p_un = p_d;
+  p_un = p_un.norm(radialDistortionInv(p_d.length(), distortion));
 
   // Now we got a ray on the z axis
   GVector::vector3d<double> v(p_un.x, p_un.y, 1);
 
   // Transform this ray into world coordinates
-  Quaternion<double> q_field2cam = Quaternion<double>(
-      q0->getDouble(),q1->getDouble(),q2->getDouble(),q3->getDouble());
-  q_field2cam.norm();
-  GVector::vector3d<double> translation =
-    GVector::vector3d<double>(tx->getDouble(),ty->getDouble(),tz->getDouble());
-
-  Quaternion<double> q_field2cam_inv = q_field2cam;
-  q_field2cam_inv.invert();
   GVector::vector3d<double> v_in_w =
       q_field2cam_inv.rotateVectorByQuaternion(v);
-  GVector::vector3d<double> zero_in_w =
-      q_field2cam_inv.rotateVectorByQuaternion(
-          GVector::vector3d<double>(0,0,0) - translation);
 
   // Compute the the point where the rays intersects the field
   double t = GVector::ray_plane_intersect(
       GVector::vector3d<double>(0,0,z), GVector::vector3d<double>(0,0,1).norm(),
-      zero_in_w, v_in_w.norm());
+      camera_in_field, v_in_w.norm());
 
   // Set p_f
-  p_f = zero_in_w + v_in_w.norm() * t;
+  p_f = camera_in_field + v_in_w.norm() * t;
 }
 
 
@@ -21,7 +21,10 @@
 
 #include <VarDouble.h>
 #include <VarList.h>
+#include <VarNotifier.h>
 #include <quaternion.h>
+#include <memory>
+#include <mutex>
 #include <Eigen/Core>
 #include "field.h"
 #include "timer.h"
@@ -47,6 +50,7 @@ public:
 
   class AdditionalCalibrationInformation;
   class CalibrationData;
+  class Snapshot;
 
   CameraParameters(int camera_index_, RoboCupField * field);
   ~CameraParameters();
@@ -94,6 +98,10 @@ public:
 
   void toProtoBuffer(SSL_GeometryCameraCalibration &buffer) const;
 
+  /// the calibration as of the last change of any parameter. Holding on to the
+  /// snapshot keeps it valid, and projecting with it takes no locks.
+  std::shared_ptr<const Snapshot> getSnapshot() const;
+
   enum
   {
     FOCAL_LENGTH=0,
@@ -159,6 +167,33 @@ public:
       generateCameraControlPoints(int cameraId, int numCamerasTotal, double fieldHeight, double fieldWidth);
   };
 
+  /*!
+  \class Snapshot
+  \brief An immutable copy of the intrinsic and extrinsic parameters
+  as plain values, with the rotation already normalized and inverted.
+   **/
+  class Snapshot
+  {
+    public:
+      explicit Snapshot(const CameraParameters& params);
+
+      double focal_length;
+      double principal_point_x;
+      double principal_point_y;
+      double distortion;
+      Quaternion<double> q_field2cam;
+      Quaternion<double> q_field2cam_inv;
+      GVector::vector3d<double> translation;
+      //the camera origin in field coordinates
+      GVector::vector3d<double> camera_in_field;
+
+      void field2image(const GVector::vector3d<double> &p_f, GVector::vector2d<double> &p_i) const;
+      void image2field(GVector::vector3d<double> &p_f, const GVector::vector2d<double> &p_i, double z) const;
+
+      static double radialDistortion(double ru, double dist);
+      static double radialDistortionInv(double rd, double dist);
+  };
+
   /*!
   \class CalibrationData
   \brief Additional structure for holding information about
@@ -205,6 +240,12 @@ public:
 public:
   void do_calibration(int cal_type);
   void reset();
+
+private:
+  //reports changes of the parameters above to getSnapshot():
+  mutable VarNotifier snapshot_notifier;
+  mutable std::mutex snapshot_mutex;
+  mutable std::shared_ptr<const Snapshot> snapshot;
 };
 
 #endif
@@ -106,6 +106,24 @@ inline static yuv uyvy2yuv(const uyvy &color_uyvy, int x) {
   return color_yuv;
 }
 
+// color of pixel (x,y) of an RGGB bayer mosaic (red at (0,0), the layout
+// opencv calls BayerBG), taken from the 2x2 window starting at (x,y).
+// Every such window holds one red, two green and one blue sample.
+// The last row and column use the window above / to the left instead.
+inline static rgb bayer2rgb(const unsigned char * src, int width, int height, int x, int y) {
+  int x0 = (x < width-1) ? x : x-1;
+  int y0 = (y < height-1) ? y : y-1;
+  const unsigned char * row_a = src + y0 * width;
+  const unsigned char * row_rg = (y0 & 1) ? row_a + width : row_a;
+  const unsigned char * row_gb = (y0 & 1) ? row_a : row_a + width;
+  int e = x0 & 1;
+  rgb color;
+  color.r = row_rg[x0 + e];
+  color.g = (row_rg[x0 + 1 - e] + row_gb[x0 + e]) >> 1;
+  color.b = row_gb[x0 + 1 - e];
+  return color;
+}
+
 //DC1394 accelerated:
 static void uyvy2rgb (unsigned char *src, unsigned char *dest, int width, int height);
 static void yuyv2rgb ( unsigned char *src, unsigned char *dest, int width, int height);
@@ -38,6 +38,11 @@ void computeMask(const ConvexHull &convex_hull, Image<raw8> &mask) {
   }
 }
 
+void ConvexHullImageMask::_updateMask() {
+  computeMask(_convex_hull, _mask);
+  _spans.compute(_mask);
+}
+
 void ConvexHullImageMask::slotMaskPointsRead() {
   lock();
   
@@ -78,6 +83,7 @@ void ConvexHullImageMask::reset() {
   
   _convex_hull.clear();
   _mask.fillColor(raw8(255));
+  _spans.compute(_mask);
   _v_list->resetToDefault();
   
   unlock();
@@ -87,7 +93,7 @@ void ConvexHullImageMask::_addPoint(const int x, const int y, const bool add_to_
   const bool changed = _convex_hull.addPoint(x, y);
 
   if (changed) {
-    computeMask(_convex_hull, _mask);
+    _updateMask();
 
     if (add_to_list) {
       VarTypes::VarList *point = new VarTypes::VarList();
@@ -115,7 +121,7 @@ void ConvexHullImageMask::removePoint(const int x, const int y, const int margin
       changed = _convex_hull.removePoint(x + w, y + h);
 
   if (changed) {
-    computeMask(_convex_hull, _mask);
+    _updateMask();
 
     _v_list->resetToDefault();
     for (auto it = _convex_hull.begin(); it != _convex_hull.end(); ++it) {
@@ -136,7 +142,7 @@ void ConvexHullImageMask::setSize(const int w, const int h) {
   lock();
   _mask.allocate(w, h);
   _mask.fillColor(raw8(255));
-  computeMask(_convex_hull, _mask);
+  _updateMask();
   unlock();
 }
 
@@ -176,6 +182,10 @@ const Image<raw8>& ConvexHullImageMask::getMask() const {
   return _mask;
 }
 
+const ImageMaskSpans& ConvexHullImageMask::getSpans() const {
+  return _spans;
+}
+
 const ConvexHull& ConvexHullImageMask::getConvexHull() const {
   return _convex_hull;
 }
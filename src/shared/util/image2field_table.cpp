@@ -0,0 +1,85 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    image2field_table.cpp
+  \brief   C++ Implementation: Image2FieldTable
+*/
+//========================================================================
+
+#include "image2field_table.h"
+#include <cmath>
+#include "worker_pool.h"
+
+Image2FieldTable::Image2FieldTable(const CameraParameters & camera_params) : camera_params(camera_params) {
+  width=0;
+  height=0;
+  z=0.0;
+  valid=false;
+  cols=0;
+  rows=0;
+}
+
+bool Image2FieldTable::update(int image_width, int image_height, double z_height, WorkerPool * pool) {
+  std::shared_ptr<const CameraParameters::Snapshot> current=camera_params.getSnapshot();
+  if (current==calibration && image_width==width && image_height==height && z_height==z) {
+    return false;
+  }
+
+  calibration=current;
+  width=image_width;
+  height=image_height;
+  z=z_height;
+  valid=false;
+  if (width <= 0 || height <= 0) return true;
+
+  //one sample past the last pixel, so that every pixel position
+  //up to (width,height) lies inside of a cell:
+  cols=width/STEP + 2;
+  rows=height/STEP + 2;
+  samples.resize(cols*rows);
+  if (pool==0) {
+    buildRows(0,rows);
+  } else {
+    int bands=pool->getConcurrency();
+    pool->run("Image2FieldTable",bands,[&](int band) {
+      int row_begin, row_end;
+      WorkerPool::splitRange(rows,bands,band,row_begin,row_end);
+      buildRows(row_begin,row_end);
+    });
+  }
+
+  //rays that do not hit the plane leave the table unusable:
+  valid=true;
+  for (size_t i=0; i<samples.size() && valid; i++) {
+    valid=std::isfinite(samples[i].x) && std::isfinite(samples[i].y);
+  }
+  return true;
+}
+
+void Image2FieldTable::buildRows(int row_begin, int row_end) {
+  GVector::vector3d<double> p_f;
+  for (int j=row_begin; j<row_end; j++) {
+    Sample * row=&samples[j*cols];
+    for (int i=0; i<cols; i++) {
+      calibration->image2field(p_f,GVector::vector2d<double>(i*STEP,j*STEP),z);
+      if (!std::isfinite(p_f.x) || !std::isfinite(p_f.y)) {
+        //the principal point itself has no direction to undistort along:
+        calibration->image2field(p_f,GVector::vector2d<double>(i*STEP+1e-3,j*STEP),z);
+      }
+      row[i].x=(float)p_f.x;
+      row[i].y=(float)p_f.y;
+    }
+  }
+}
@@ -0,0 +1,104 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    image2field_table.h
+  \brief   C++ Interface: Image2FieldTable
+*/
+//========================================================================
+
+#ifndef IMAGE2FIELD_TABLE_H
+#define IMAGE2FIELD_TABLE_H
+
+#include <vector>
+#include "camera_calibration.h"
+
+class WorkerPool;
+
+/*!
+  \class   Image2FieldTable
+  \brief   CameraParameters::image2field() for one fixed height, as a table lookup
+
+  The field position at height z is sampled every STEP pixels, and
+  interpolated bilinearly in between. The projection is smooth enough for
+  the interpolation error to stay far below a millimeter.
+
+  update() rebuilds the table whenever the calibration snapshot, the image
+  size or the height changed since the last call. It must not run
+  concurrently with image2field(), which may be called by several threads
+  at once otherwise.
+*/
+class Image2FieldTable {
+protected:
+  struct Sample {
+    float x;
+    float y;
+  };
+
+  const CameraParameters & camera_params;
+  // the snapshot the table was built from
+  std::shared_ptr<const CameraParameters::Snapshot> calibration;
+  int width;
+  int height;
+  double z;
+  bool valid;
+
+  // samples of the pixels (i*STEP,j*STEP), row by row
+  int cols;
+  int rows;
+  std::vector<Sample> samples;
+
+  void buildRows(int row_begin, int row_end);
+public:
+  static const int STEP = 4;
+
+  Image2FieldTable(const CameraParameters & camera_params);
+
+  /// rebuilds the table if anything it depends on changed, the rows in parallel if a
+  /// pool is given. Returns true if the table was rebuilt.
+  bool update(int image_width, int image_height, double z_height, WorkerPool * pool=0);
+
+  /// the height the table was built for
+  double getHeight() const {
+    return z;
+  }
+
+  /// same as CameraParameters::image2field(p_f,p_i,getHeight()). Points outside of the
+  /// image are projected by the calibration snapshot directly.
+  void image2field(GVector::vector3d<double> & p_f, const GVector::vector2d<double> & p_i) const {
+    double gx=p_i.x*(1.0/STEP);
+    double gy=p_i.y*(1.0/STEP);
+    if (!valid || !(gx >= 0.0 && gy >= 0.0 && gx < cols-1 && gy < rows-1)) {
+      if (calibration) {
+        calibration->image2field(p_f,p_i,z);
+      } else {
+        camera_params.image2field(p_f,p_i,z);
+      }
+      return;
+    }
+    int ix=(int)gx;
+    int iy=(int)gy;
+    double fx=gx-ix;
+    double fy=gy-iy;
+    const Sample * s=&samples[iy*cols + ix];
+    const Sample * t=s + cols;
+    double x_top=s[0].x + fx*(s[1].x - s[0].x);
+    double y_top=s[0].y + fx*(s[1].y - s[0].y);
+    double x_bottom=t[0].x + fx*(t[1].x - t[0].x);
+    double y_bottom=t[0].y + fx*(t[1].y - t[0].y);
+    p_f.set(x_top + fy*(x_bottom - x_top),y_top + fy*(y_bottom - y_top),z);
+  }
+};
+
+#endif
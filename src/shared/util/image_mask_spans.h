@@ -0,0 +1,101 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    image_mask_spans.h
+  \brief   C++ Interface: ImageMaskSpans
+*/
+//========================================================================
+
+#ifndef IMAGE_MASK_SPANS_H
+#define IMAGE_MASK_SPANS_H
+
+#include <vector>
+#include "image.h"
+
+/// a horizontal run [x_begin,x_end) of pixels that are not masked out
+struct MaskSpan {
+  int x_begin;
+  int x_end;
+};
+
+/*!
+  \class   ImageMaskSpans
+  \brief   The unmasked pixels of a binary image mask, stored as spans per row
+
+  A pixel is unmasked if its mask value is 255 (all bits set), which is
+  the only value besides 0 an image mask holds. Processing that iterates
+  over the spans never visits masked pixels, and does not need to read the
+  mask image at all.
+*/
+class ImageMaskSpans {
+protected:
+  int width;
+  int height;
+  int num_pixels;
+  // spans of row y are spans[row_offsets[y]] ... spans[row_offsets[y+1]-1]
+  std::vector<int> row_offsets;
+  std::vector<MaskSpan> spans;
+public:
+  ImageMaskSpans() {
+    width=0;
+    height=0;
+    num_pixels=0;
+    row_offsets.assign(1,0);
+  }
+
+  void compute(const Image<raw8> & mask) {
+    width=mask.getWidth();
+    height=mask.getHeight();
+    num_pixels=0;
+    row_offsets.resize(height+1);
+    spans.clear();
+    const raw8 * data=mask.getPixelData();
+    for (int y=0; y<height; y++) {
+      row_offsets[y]=(int)spans.size();
+      const raw8 * row=data + y*width;
+      int x=0;
+      while (x < width) {
+        while (x < width && row[x].v!=255) x++;
+        if (x==width) break;
+        MaskSpan span;
+        span.x_begin=x;
+        while (x < width && row[x].v==255) x++;
+        span.x_end=x;
+        num_pixels+=span.x_end-span.x_begin;
+        spans.push_back(span);
+      }
+    }
+    row_offsets[height]=(int)spans.size();
+  }
+
+  int getWidth() const {
+    return width;
+  }
+  int getHeight() const {
+    return height;
+  }
+  /// number of unmasked pixels
+  int getNumPixels() const {
+    return num_pixels;
+  }
+  const MaskSpan * rowBegin(int y) const {
+    return spans.data() + row_offsets[y];
+  }
+  const MaskSpan * rowEnd(int y) const {
+    return spans.data() + row_offsets[y+1];
+  }
+};
+
+#endif
@@ -24,6 +24,7 @@
 #include <stdio.h>
 
 #include <queue>
+#include <vector>
 
 #include "util.h"
 #include "nvector.h"
@@ -72,57 +73,82 @@ public:
       {return(dist > qn.dist);}
   };
 
+  typedef std::priority_queue<QueryNode> _PriorityQueue;
+  class PriorityQueue : public _PriorityQueue{
+  public:
+    void clear() {_PriorityQueue::c.clear();}
+  };
+
+  // State of an iterative query. The tree itself is not changed by a
+  // query, so several threads can each run their own query on it.
+  struct Query{
+    vec_t query_point;
+    double query_max_dist;
+    PriorityQueue queue;
+  };
+
 protected:
   Node *root;
   int leaf_size,max_depth;
   int is_built;
 
-  vec_t query_point;
-  double query_max_dist;
+  // Nodes come from a pool of fixed size blocks, which is kept when the
+  // tree is cleared. A tree that is rebuilt every frame therefore stops
+  // allocating once the pool has grown to its largest size, and its nodes
+  // end up next to each other in memory.
+  static const int NODE_BLOCK_SIZE = 256;
+  std::vector<Node *> node_blocks;
+  int num_nodes;
+
   vec_t scale;
 
-  typedef std::priority_queue<QueryNode> _PriorityQueue;
-  class PriorityQueue : public _PriorityQueue{
-  public:
-    void clear() {_PriorityQueue::c.clear();}
-  };
-  PriorityQueue queue;
+  Query query; // used by the query functions without a Query argument
 
 protected:
-  double distFromQuery(Node *p);
-  double distFromQuery(state_t *s);
+  double distFromQuery(const Query &q,Node *p) const;
+  double distFromQuery(const Query &q,state_t *s) const;
 
   void initBBox(BBox &b,state_t &s);
   void updateBBox(BBox &b,state_t &s);
   void calcBBox(BBox &b,state_t *s);
   void calcBBox(BBox &b,BBox &c1,BBox &c2);
 
-  void freeTree(Node *p);
+  Node *allocNode();
+  void freeNodes();
   void add(Node **q,state_t *s,int level);
   void split(Node *p,int level);
 
-  void addToSearchQueue(Node *p);
-  void addToSearchQueue(state_t *s);
+  void addToSearchQueue(Query &q,Node *p) const;
+  void addToSearchQueue(Query &q,state_t *s) const;
 
-  state_t *getOnlyNearest(Node *t,state_t *nearest);
+  state_t *getOnlyNearest(Query &q,Node *t,state_t *nearest) const;
 
   void draw(const Node *t,int levels) const;
 
 public:
-  NKDTree() {root=NULL; leaf_size=16; max_depth=20; scale.set(1.0);}
-  ~NKDTree() {clear();}
+  NKDTree() {root=NULL; leaf_size=16; max_depth=20; is_built=false; num_nodes=0; scale.set(1.0);}
+  ~NKDTree() {freeNodes();}
 
   void add(state_t *s) {add(&root,s,0);}
   void build();
-  void clear() {freeTree(root); root=NULL; is_built=false;}
+  // releases all nodes to the pool
+  void clear() {root=NULL; num_nodes=0; is_built=false;}
   void setScale(int dim_idx,num_t val)
     {scale[dim_idx]=val;}
 
   // multiple state iterative query
-  void startQuery(const state_t &_query_point,double _query_max_dist);
-  void startQuery(const vec_t &_query_point,double _query_max_dist);
-  state_t *getNextNearest(double &dist);
-  void endQuery() {queue.clear();}
+  void startQuery(Query &q,const state_t &_query_point,double _query_max_dist) const;
+  void startQuery(Query &q,const vec_t &_query_point,double _query_max_dist) const;
+  state_t *getNextNearest(Query &q,double &dist) const;
+  void endQuery(Query &q) const {q.queue.clear();}
+
+  void startQuery(const state_t &_query_point,double _query_max_dist)
+    {startQuery(query,_query_point,_query_max_dist);}
+  void startQuery(const vec_t &_query_point,double _query_max_dist)
+    {startQuery(query,_query_point,_query_max_dist);}
+  state_t *getNextNearest(double &dist)
+    {return(getNextNearest(query,dist));}
+  void endQuery() {endQuery(query);}
 
   // single shot query
   state_t *getOnlyNearest(const state_t &s,double &max_dist);
@@ -134,31 +160,31 @@ public:
 };
 
 NKD_TEM
-double NKD_FUN::distFromQuery(Node *p)
+double NKD_FUN::distFromQuery(const Query &q,Node *p) const
 {
   vec_t near;
-  near.bound(query_point, p->min, p->max);
+  near.bound(q.query_point, p->min, p->max);
   if(!scaled){
-    return(dist(query_point, near));
+    return(dist(q.query_point, near));
   }else{
     double d = 0.0;
     for(int i=0; i<dim; i++){
-      d += sq((query_point[i] - near[i]) * scale[i]);
+      d += sq((q.query_point[i] - near[i]) * scale[i]);
     }
     return(sqrt(d));
   }
 }
 
 NKD_TEM
-double NKD_FUN::distFromQuery(state_t *s)
+double NKD_FUN::distFromQuery(const Query &q,state_t *s) const
 {
   int i;
   double d = 0.0;
   for(i=0; i<dim; i++){
     if(!scaled){
-      d += sq(query_point[i] - (*s)[i]);
+      d += sq(q.query_point[i] - (*s)[i]);
     }else{
-      d += sq(query_point[i] - (*s)[i]) * scale[i];
+      d += sq(q.query_point[i] - (*s)[i]) * scale[i];
     }
   }
   return(sqrt(d));
@@ -214,13 +240,25 @@ void NKD_FUN::calcBBox(BBox &b,BBox &c1,BBox &c2)
 }
 
 NKD_TEM
-void NKD_FUN::freeTree(Node *p)
+typename NKD_FUN::Node *NKD_FUN::allocNode()
+{
+  int block = num_nodes / NODE_BLOCK_SIZE;
+  if(block == (int)node_blocks.size()){
+    node_blocks.push_back(new Node[NODE_BLOCK_SIZE]);
+  }
+  Node *p = &node_blocks[block][num_nodes % NODE_BLOCK_SIZE];
+  num_nodes++;
+  return(p);
+}
+
+NKD_TEM
+void NKD_FUN::freeNodes()
 {
-  if(p){
-    freeTree(p->child[0]); p->child[0]=NULL;
-    freeTree(p->child[1]); p->child[1]=NULL;
-    delete(p);
+  for(unsigned i=0; i<node_blocks.size(); i++){
+    delete[] node_blocks[i];
   }
+  node_blocks.clear();
+  clear();
 }
 
 NKD_TEM
@@ -235,7 +273,7 @@ void NKD_FUN::add(Node **q,state_t *s,int level)
 
     // make a new node if none exists here
     if(!p){
-      *q = p = new Node;
+      *q = p = allocNode();
       mzero(*p);
       initBBox(*p,*s);
     }
@@ -314,58 +352,58 @@ void NKD_FUN::build()
 }
 
 NKD_TEM
-void NKD_FUN::startQuery(const state_t &_query_point,double _query_max_dist)
+void NKD_FUN::startQuery(Query &q,const state_t &_query_point,double _query_max_dist) const
 {
-  endQuery();
-  for(int i=0; i<dim; i++) query_point[i] = _query_point[i];
-  query_max_dist = _query_max_dist;
-  if(root) addToSearchQueue(root);
+  endQuery(q);
+  for(int i=0; i<dim; i++) q.query_point[i] = _query_point[i];
+  q.query_max_dist = _query_max_dist;
+  if(root) addToSearchQueue(q,root);
 }
 
 NKD_TEM
-void NKD_FUN::startQuery(const vec_t &_query_point,double _query_max_dist)
+void NKD_FUN::startQuery(Query &q,const vec_t &_query_point,double _query_max_dist) const
 {
-  endQuery();
-  query_point = _query_point;
-  query_max_dist = _query_max_dist;
-  if(root) addToSearchQueue(root);
+  endQuery(q);
+  q.query_point = _query_point;
+  q.query_max_dist = _query_max_dist;
+  if(root) addToSearchQueue(q,root);
 }
 
 NKD_TEM
-void NKD_FUN::addToSearchQueue(Node *p)
+void NKD_FUN::addToSearchQueue(Query &q,Node *p) const
 {
   QueryNode qn;
-  qn.dist = distFromQuery(p);
-  if(qn.dist < query_max_dist){
+  qn.dist = distFromQuery(q,p);
+  if(qn.dist < q.query_max_dist){
     qn.node = p;
     qn.state = NULL;
-    queue.push(qn);
+    q.queue.push(qn);
   }
 }
 
 NKD_TEM
-void NKD_FUN::addToSearchQueue(state_t *s)
+void NKD_FUN::addToSearchQueue(Query &q,state_t *s) const
 {
   QueryNode qn;
-  qn.dist = distFromQuery(s);
-  if(qn.dist < query_max_dist){
+  qn.dist = distFromQuery(q,s);
+  if(qn.dist < q.query_max_dist){
     qn.node = NULL;
     qn.state = s;
-    queue.push(qn);
+    q.queue.push(qn);
   }
 }
 
 NKD_TEM
-state_t *NKD_FUN::getNextNearest(double &dist)
+state_t *NKD_FUN::getNextNearest(Query &q,double &dist) const
 {
   get_next next;
   QueryNode qn;
   state_t *s;
 
-  while(queue.size() > 0){
+  while(q.queue.size() > 0){
     // get head of priority queue
-    qn = queue.top();
-    queue.pop();
+    qn = q.queue.top();
+    q.queue.pop();
 
     // if its a raw state, return it
     if(qn.state){
@@ -376,13 +414,13 @@ state_t *NKD_FUN::getNextNearest(double &dist)
     // otherwise it is a node, so we have to expand it
 
     // expand nodes
-    if(qn.node->child[0]) addToSearchQueue(qn.node->child[0]);
-    if(qn.node->child[1]) addToSearchQueue(qn.node->child[1]);
+    if(qn.node->child[0]) addToSearchQueue(q,qn.node->child[0]);
+    if(qn.node->child[1]) addToSearchQueue(q,qn.node->child[1]);
 
     // expand states
     s = qn.node->states;
     while(s){
-      addToSearchQueue(s);
+      addToSearchQueue(q,s);
       s = next(s);
     }
   }
@@ -392,24 +430,24 @@ state_t *NKD_FUN::getNextNearest(double &dist)
 }
 
 NKD_TEM
-state_t *NKD_FUN::getOnlyNearest(Node *t,state_t *nearest)
+state_t *NKD_FUN::getOnlyNearest(Query &q,Node *t,state_t *nearest) const
 {
   get_next next;
   state_t *s;
   double d;
 
   // pruning
-  if(t==NULL || distFromQuery(t)>query_max_dist) return(nearest);
+  if(t==NULL || distFromQuery(q,t)>q.query_max_dist) return(nearest);
 
   // we either store states (leaf) or are have children (interal node)
   if(t->states){
     // leaf node, check the states stored here to update the nearest
     s = t->states;
     while(s){
-      d = distFromQuery(s);
-      if(d < query_max_dist){
+      d = distFromQuery(q,s);
+      if(d < q.query_max_dist){
         nearest = s;
-        query_max_dist = d;
+        q.query_max_dist = d;
       }
       s = next(s);
     }
@@ -417,9 +455,9 @@ state_t *NKD_FUN::getOnlyNearest(Node *t,state_t *nearest)
     // internal node, find out which side of the plane our query is on
     // and descend the tree on that side first, followed by the
     // further side.
-    int i = query_point[t->split_dim] > t->threshold;
-    nearest = getOnlyNearest(t->child[ i],nearest);
-    nearest = getOnlyNearest(t->child[!i],nearest);
+    int i = q.query_point[t->split_dim] > t->threshold;
+    nearest = getOnlyNearest(q,t->child[ i],nearest);
+    nearest = getOnlyNearest(q,t->child[!i],nearest);
   }
 
   return(nearest);
@@ -437,10 +475,10 @@ state_t *NKD_FUN::getOnlyNearest(const state_t &s,double &max_dist)
   endQuery();
   */
 
-  for(int i=0; i<dim; i++) query_point[i] = s[i];
-  query_max_dist = max_dist;
-  sn = getOnlyNearest(root,NULL);
-  max_dist = query_max_dist;
+  for(int i=0; i<dim; i++) query.query_point[i] = s[i];
+  query.query_max_dist = max_dist;
+  sn = getOnlyNearest(query,root,NULL);
+  max_dist = query.query_max_dist;
   return(sn);
 }
 
@@ -0,0 +1,218 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    raw_video.cpp
+  \brief   C++ Implementation: RawVideoWriter, RawVideoReader
+*/
+//========================================================================
+
+#include "raw_video.h"
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static_assert(sizeof(RawVideoHeader) == 32, "unexpected raw video header layout");
+static_assert(sizeof(RawVideoIndexEntry) == 32, "unexpected raw video index layout");
+
+RawVideoWriter::RawVideoWriter()
+{
+  file=0;
+  position=0;
+}
+
+RawVideoWriter::~RawVideoWriter()
+{
+  close();
+}
+
+bool RawVideoWriter::writeHeader(uint64_t index_offset)
+{
+  RawVideoHeader header;
+  memset(&header,0,sizeof(header));
+  memcpy(header.magic,RAW_VIDEO_MAGIC,sizeof(RAW_VIDEO_MAGIC));
+  header.version=RAW_VIDEO_VERSION;
+  header.header_size=sizeof(RawVideoHeader);
+  header.frame_count=index.size();
+  header.index_offset=index_offset;
+  return fseeko(file,0,SEEK_SET)==0 && fwrite(&header,sizeof(header),1,file)==1;
+}
+
+bool RawVideoWriter::open(const std::string & filename)
+{
+  close();
+  file=fopen(filename.c_str(),"wb");
+  if (file==0) {
+    fprintf(stderr,"RawVideoWriter: unable to open %s for writing\n",filename.c_str());
+    return false;
+  }
+  index.clear();
+  //the index offset stays 0 until the file was closed properly
+  if (!writeHeader(0)) {
+    fclose(file);
+    file=0;
+    return false;
+  }
+  position=sizeof(RawVideoHeader);
+  return true;
+}
+
+bool RawVideoWriter::append(const RawImage & img)
+{
+  if (file==0 || img.getData()==0) return false;
+  RawVideoIndexEntry entry;
+  memset(&entry,0,sizeof(entry));
+  entry.offset=((position + RAW_VIDEO_ALIGNMENT - 1) / RAW_VIDEO_ALIGNMENT) * RAW_VIDEO_ALIGNMENT;
+  entry.size=img.getNumBytes();
+  entry.width=img.getWidth();
+  entry.height=img.getHeight();
+  entry.format=img.getColorFormat();
+  entry.timestamp=img.getTime();
+  if (fseeko(file,entry.offset,SEEK_SET)!=0 ||
+      fwrite(img.getData(),1,entry.size,file)!=entry.size) {
+    fprintf(stderr,"RawVideoWriter: error writing frame %d\n",(int)index.size());
+    return false;
+  }
+  position=entry.offset+entry.size;
+  index.push_back(entry);
+  return true;
+}
+
+bool RawVideoWriter::close()
+{
+  if (file==0) return false;
+  uint64_t index_offset=((position + 7) / 8) * 8;
+  bool ok = fseeko(file,index_offset,SEEK_SET)==0;
+  if (ok && index.empty()==false) {
+    ok = fwrite(&index[0],sizeof(RawVideoIndexEntry),index.size(),file)==index.size();
+  }
+  ok = ok && writeHeader(index_offset);
+  ok = (fclose(file)==0) && ok;
+  file=0;
+  if (!ok) {
+    fprintf(stderr,"RawVideoWriter: error finalizing file\n");
+  }
+  return ok;
+}
+
+bool RawVideoWriter::isOpen() const
+{
+  return file!=0;
+}
+
+int RawVideoWriter::getFrameCount() const
+{
+  return (int)index.size();
+}
+
+RawVideoReader::RawVideoReader()
+{
+  mapping_size=0;
+  index=0;
+  frame_count=0;
+}
+
+RawVideoReader::~RawVideoReader()
+{
+  close();
+}
+
+bool RawVideoReader::open(const std::string & filename)
+{
+  close();
+  int fd=::open(filename.c_str(),O_RDONLY);
+  if (fd<0) {
+    fprintf(stderr,"RawVideoReader: unable to open %s\n",filename.c_str());
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd,&st)!=0 || (size_t)st.st_size < sizeof(RawVideoHeader)) {
+    fprintf(stderr,"RawVideoReader: %s is not a raw video file\n",filename.c_str());
+    ::close(fd);
+    return false;
+  }
+  size_t size=st.st_size;
+  //private mapping: frames may be modified in memory, the file never is
+  void * data=mmap(0,size,PROT_READ | PROT_WRITE,MAP_PRIVATE,fd,0);
+  ::close(fd);
+  if (data==MAP_FAILED) {
+    fprintf(stderr,"RawVideoReader: unable to map %s\n",filename.c_str());
+    return false;
+  }
+  std::shared_ptr<void> map(data,[size](void * p) { munmap(p,size); });
+
+  const RawVideoHeader * header=(const RawVideoHeader *)data;
+  if (memcmp(header->magic,RAW_VIDEO_MAGIC,sizeof(RAW_VIDEO_MAGIC))!=0 ||
+      header->version!=RAW_VIDEO_VERSION) {
+    fprintf(stderr,"RawVideoReader: %s is not a raw video file\n",filename.c_str());
+    return false;
+  }
+  if (header->index_offset==0 ||
+      header->index_offset + header->frame_count * sizeof(RawVideoIndexEntry) > size) {
+    fprintf(stderr,"RawVideoReader: %s has no valid index (recording not closed?)\n",filename.c_str());
+    return false;
+  }
+  const RawVideoIndexEntry * entries=(const RawVideoIndexEntry *)((const char *)data + header->index_offset);
+  for (uint64_t i=0;i<header->frame_count;i++) {
+    if (entries[i].offset + entries[i].size > size ||
+        (int)entries[i].size != RawImage::computeImageSize((ColorFormat)entries[i].format,entries[i].width*entries[i].height)) {
+      fprintf(stderr,"RawVideoReader: %s has a corrupt index entry at frame %d\n",filename.c_str(),(int)i);
+      return false;
+    }
+  }
+
+  mapping=map;
+  mapping_size=size;
+  index=entries;
+  frame_count=(int)header->frame_count;
+  madvise(data,size,MADV_SEQUENTIAL);
+  return true;
+}
+
+void RawVideoReader::close()
+{
+  mapping.reset();
+  mapping_size=0;
+  index=0;
+  frame_count=0;
+}
+
+bool RawVideoReader::isOpen() const
+{
+  return (bool)mapping;
+}
+
+int RawVideoReader::getFrameCount() const
+{
+  return frame_count;
+}
+
+double RawVideoReader::getTime(int i) const
+{
+  if (i < 0 || i >= frame_count) return 0.0;
+  return index[i].timestamp;
+}
+
+RawImage RawVideoReader::getFrame(int i) const
+{
+  RawImage img;
+  if (i < 0 || i >= frame_count) return img;
+  const RawVideoIndexEntry & entry=index[i];
+  img.lend((unsigned char *)mapping.get() + entry.offset,(ColorFormat)entry.format,
+           entry.width,entry.height,mapping);
+  img.setTime(entry.timestamp);
+  return img;
+}
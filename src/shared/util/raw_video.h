@@ -0,0 +1,115 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    raw_video.h
+  \brief   C++ Interface: RawVideoWriter, RawVideoReader
+*/
+//========================================================================
+
+#ifndef RAW_VIDEO_H
+#define RAW_VIDEO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include "rawimage.h"
+
+/*!
+  \brief On-disk layout of a raw video file
+
+  A raw video file stores frames in their native capture format together
+  with their capture timestamps:
+
+    [header][frame 0][frame 1]...[frame n-1][index]
+
+  Every frame starts at a multiple of RAW_VIDEO_ALIGNMENT so that it can be
+  used directly from a memory mapping. The index holds one entry per frame
+  and is written when the file is closed, after which the header points to it.
+  All values are stored in host (little-endian) byte order.
+*/
+#define RAW_VIDEO_MAGIC "SSLRAWV"
+#define RAW_VIDEO_VERSION 1
+#define RAW_VIDEO_ALIGNMENT 4096
+
+struct RawVideoHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t frame_count;
+  uint64_t index_offset;
+};
+
+struct RawVideoIndexEntry {
+  uint64_t offset;
+  uint32_t size;
+  uint32_t width;
+  uint32_t height;
+  int32_t format;
+  double timestamp;
+};
+
+/*!
+  \class  RawVideoWriter
+  \brief  Appends frames to a new raw video file
+*/
+class RawVideoWriter {
+protected:
+  FILE * file;
+  uint64_t position;
+  std::vector<RawVideoIndexEntry> index;
+  bool writeHeader(uint64_t index_offset);
+public:
+  RawVideoWriter();
+  ~RawVideoWriter();
+
+  bool open(const std::string & filename);
+  bool append(const RawImage & img);
+  /// writes the index and finalizes the header
+  bool close();
+  bool isOpen() const;
+  int getFrameCount() const;
+};
+
+/*!
+  \class  RawVideoReader
+  \brief  Provides random access to the frames of a raw video file
+
+  The file is memory-mapped. Frames are returned as RawImages that borrow
+  the mapping (see RawImage::lend()), so they stay valid even after the
+  reader was closed.
+*/
+class RawVideoReader {
+protected:
+  std::shared_ptr<void> mapping;
+  size_t mapping_size;
+  const RawVideoIndexEntry * index;
+  int frame_count;
+public:
+  RawVideoReader();
+  ~RawVideoReader();
+
+  bool open(const std::string & filename);
+  void close();
+  bool isOpen() const;
+  int getFrameCount() const;
+  /// capture timestamp of frame \p i
+  double getTime(int i) const;
+  /// returns frame \p i with its capture timestamp, or an empty image if out of range
+  RawImage getFrame(int i) const;
+};
+
+#endif
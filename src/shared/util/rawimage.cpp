@@ -106,16 +106,18 @@ void RawImage::setTime(double t)
 
 void RawImage::setData(unsigned char * d)
 {
-  if (data!=0) delete[] data;
+  if (data!=0 && !lease) delete[] data;
+  lease.reset();
   data=d;
 }
 
 void  RawImage::allocate (ColorFormat fmt, int w, int h)
 {
   if(w >= 0 && h >= 0) {
-    if (data!=0) {
+    if (data!=0 && !lease) {
       delete[] data;
     }
+    lease.reset();
     if (w==0 && h==0) {
       data=0;
     } else {
@@ -129,7 +131,8 @@ void  RawImage::allocate (ColorFormat fmt, int w, int h)
 
 void  RawImage::ensure_allocation (ColorFormat fmt, int w, int h)
 {
-  if(data == 0 || format != fmt || width != w || height!=h) {
+  //never write into a buffer that we only borrowed
+  if(data == 0 || lease || format != fmt || width != w || height!=h) {
     allocate(fmt,w,h);
   }
 }
@@ -148,6 +151,47 @@ void RawImage::clear()
   allocate(getColorFormat(),0,0);
 };
 
+/*!
+  Points this image at a buffer that is owned by someone else, typically a
+  capture driver. \p owner keeps the buffer alive: it is shared by all copies
+  of this image and released once the last of them is reallocated, cleared or
+  lent another buffer. Drivers use the release to return the buffer to their pool.
+*/
+void RawImage::lend(unsigned char * d, ColorFormat fmt, int w, int h, const std::shared_ptr<void> & owner)
+{
+  if (data!=0 && data!=d && !lease) delete[] data;
+  lease=owner;
+  data=d;
+  format=fmt;
+  width=w;
+  height=h;
+}
+
+bool RawImage::lend(const RawImage & img)
+{
+  //only shared buffers can be lent, anything else has a single owner
+  if (!img.lease) return false;
+  lend(img.data,img.format,img.width,img.height,img.lease);
+  time=img.time;
+  return true;
+}
+
+void RawImage::allocateShared(ColorFormat fmt, int w, int h)
+{
+  unsigned char * d=new unsigned char[computeImageSize(fmt,w*h)];
+  lend(d,fmt,w,h,std::shared_ptr<void>(d,[](void * p) { delete[] (unsigned char *)p; }));
+}
+
+bool RawImage::isLent() const
+{
+  return (bool)lease;
+}
+
+const std::shared_ptr<void> & RawImage::getLease() const
+{
+  return lease;
+}
+
 int RawImage::computeImageSize(ColorFormat fmt, int pixelCount)
 {
   switch (fmt) {
@@ -176,6 +220,8 @@ rgb RawImage::getRgb(int x, int y) const
   } else if(getColorFormat() == COLOR_YUV422_UYVY) {
     yuv color_yuv = getYuv(x, y);
     return Conversions::yuv2rgb(color_yuv);
+  } else if(getColorFormat() == COLOR_RAW8 && getWidth() > 1 && getHeight() > 1) {
+    return Conversions::bayer2rgb(getData(), getWidth(), getHeight(), x, y);
   }
   return rgb{};
 }
@@ -190,6 +236,8 @@ yuv RawImage::getYuv(int x, int y) const
     uyvy* color = (uyvy*) getData();
     color += (y * getWidth() + x) / 2;
     return Conversions::uyvy2yuv(*color, x);
+  } else if(getColorFormat() == COLOR_RAW8) {
+    return Conversions::rgb2yuv(getRgb(x, y));
   }
   return yuv{};
 }
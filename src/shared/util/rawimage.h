@@ -23,6 +23,7 @@
 #define RAWIMAGE_H
 #include "image_interface.h"
 #include "colors.h"
+#include <memory>
 
 /*!
   \class  RawImage
@@ -54,6 +55,10 @@ class RawImage : public ImageInterface
   /// capture timestamp of the image
   double   time;
 
+  /// owner reference of a shared buffer (see lend()).
+  /// if set, \p data is not deleted by this image.
+  std::shared_ptr<void> lease;
+
   public:
   RawImage();
 
@@ -83,6 +88,13 @@ class RawImage : public ImageInterface
   void deepCopyFromRawImage(const RawImage & img, bool copyMetaData);
   void clear();
 
+  //shared buffers:
+  void lend(unsigned char * d, ColorFormat fmt, int w, int h, const std::shared_ptr<void> & owner);
+  bool lend(const RawImage & img);
+  void allocateShared(ColorFormat fmt, int w, int h);
+  bool isLent() const;
+  const std::shared_ptr<void> & getLease() const;
+
   //helpers:
   static int computeImageSize(ColorFormat fmt, int pixelCount);
 
@@ -0,0 +1,188 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    worker_pool.cpp
+  \brief   C++ Implementation: WorkerPool
+*/
+//========================================================================
+
+#include "worker_pool.h"
+#include <stdio.h>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+WorkerPool::WorkerPool()
+{
+  settings = new VarList("Worker Pool");
+  v_threads = new VarInt("number of threads", 0, 0, 32);
+  settings->addChild(v_threads);
+  v_print_timings = new VarBool("print band timings", false);
+  settings->addChild(v_print_timings);
+
+  claim = 0;
+  pending_bands = 0;
+  stopping = false;
+  job = nullptr;
+}
+
+WorkerPool::~WorkerPool()
+{
+  stopThreads();
+  delete settings;
+  delete v_threads;
+  delete v_print_timings;
+}
+
+VarList * WorkerPool::getSettings()
+{
+  return settings;
+}
+
+int WorkerPool::getConcurrency() const
+{
+  return v_threads->getInt() + 1;
+}
+
+const std::vector<double> & WorkerPool::getBandTimes() const
+{
+  return band_times;
+}
+
+void WorkerPool::splitRange(int n, int parts, int part, int & begin, int & end)
+{
+  begin = (int)(((int64_t)n * part) / parts);
+  end = (int)(((int64_t)n * (part + 1)) / parts);
+}
+
+void WorkerPool::startThreads(int n)
+{
+  uint32_t generation = (uint32_t)(claim.load() >> 32);
+  stopping = false;
+  for (int i = 0; i < n; i++) {
+    threads.emplace_back(&WorkerPool::workerLoop, this, generation);
+  }
+}
+
+void WorkerPool::stopThreads()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake_cond.notify_all();
+  for (auto & thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+}
+
+void WorkerPool::workerLoop(uint32_t generation)
+{
+  while (true) {
+    int spins = 0;
+    while ((uint32_t)(claim.load(std::memory_order_acquire) >> 32) == generation &&
+           stopping.load(std::memory_order_relaxed) == false && spins < SPIN_ITERATIONS) {
+      cpuRelax();
+      spins++;
+    }
+    if ((uint32_t)(claim.load(std::memory_order_acquire) >> 32) == generation) {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake_cond.wait(lock, [&] {
+        return stopping.load() || (uint32_t)(claim.load() >> 32) != generation;
+      });
+    }
+    if (stopping.load()) return;
+    generation = (uint32_t)(claim.load(std::memory_order_acquire) >> 32);
+    work(generation);
+  }
+}
+
+void WorkerPool::work(uint32_t generation)
+{
+  while (true) {
+    uint64_t c = claim.load(std::memory_order_acquire);
+    //a late thread may still look at a job that has already been completed;
+    //its claim then fails as the generation has moved on
+    if ((uint32_t)(c >> 32) != generation) return;
+    int band = (int)(c & 0xFFFF);
+    if (band >= (int)((c >> 16) & 0xFFFF)) return;
+    if (claim.compare_exchange_weak(c, c + 1, std::memory_order_acq_rel) == false) continue;
+
+    auto start = std::chrono::steady_clock::now();
+    (*job)(band);
+    band_times[band] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    if (pending_bands.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::lock_guard<std::mutex> lock(mutex);
+      done_cond.notify_one();
+    }
+  }
+}
+
+void WorkerPool::run(const std::string & name, int bands, const std::function<void(int)> & _job)
+{
+  int n = v_threads->getInt();
+  if ((int)threads.size() != n) {
+    stopThreads();
+    startThreads(n);
+  }
+
+  if (bands > MAX_BANDS) {
+    fprintf(stderr, "WorkerPool: %s was split into %d bands, but at most %d are supported\n",
+            name.c_str(), bands, MAX_BANDS);
+    bands = 0;
+  }
+  band_times.assign(bands, 0.0);
+  if (bands <= 0) return;
+
+  job = &_job;
+  pending_bands = bands;
+  uint32_t generation = (uint32_t)(claim.load() >> 32) + 1;
+  {
+    //published under the lock, so that no sleeping worker misses it
+    std::lock_guard<std::mutex> lock(mutex);
+    claim.store(((uint64_t)generation << 32) | ((uint64_t)bands << 16), std::memory_order_release);
+  }
+  wake_cond.notify_all();
+
+  work(generation);
+
+  int spins = 0;
+  while (pending_bands.load(std::memory_order_acquire) > 0 && spins < SPIN_ITERATIONS) {
+    cpuRelax();
+    spins++;
+  }
+  if (pending_bands.load(std::memory_order_acquire) > 0) {
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cond.wait(lock, [&] { return pending_bands.load() == 0; });
+  }
+  job = nullptr;
+
+  if (v_print_timings->getBool()) {
+    for (int i = 0; i < bands; i++) {
+      std::cout << std::setw(23) << std::left << (name + " band " + std::to_string(i))
+                << std::setw(5) << std::right << (int)band_times[i] << " μs" << std::endl;
+    }
+  }
+}
@@ -0,0 +1,97 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    worker_pool.h
+  \brief   C++ Interface: WorkerPool
+*/
+//========================================================================
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "VarTypes.h"
+
+/*!
+  \class   WorkerPool
+  \brief   Persistent threads that run the bands of a data-parallel job
+
+  A job is split into a number of bands, which are claimed one at a time
+  by the worker threads and by the thread calling run(). run() returns
+  once every band has finished.
+
+  Idle workers spin for a short while before they go to sleep, as the
+  processing stages of a frame follow each other closely: the next job
+  is usually picked up without a wakeup through the kernel.
+
+  Each stack owns one pool, which is shared by all of its plugins.
+  run() must not be called from more than one thread at a time.
+*/
+class WorkerPool {
+protected:
+  VarList * settings;
+  VarInt * v_threads;
+  VarBool * v_print_timings;
+
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable wake_cond;
+  std::condition_variable done_cond;
+
+  // generation of the current job (bits 32-63), its number of bands (bits 16-31)
+  // and the next unclaimed band (bits 0-15), so that one compare-and-swap claims
+  // a band of exactly the job the thread has seen
+  std::atomic<uint64_t> claim;
+  std::atomic<int> pending_bands;
+  std::atomic<bool> stopping;
+  const std::function<void(int)> * job;
+  std::vector<double> band_times;
+
+  void workerLoop(uint32_t generation);
+  void work(uint32_t generation);
+  void startThreads(int n);
+  void stopThreads();
+public:
+  /// how often an idle thread polls for new work before going to sleep
+  static const int SPIN_ITERATIONS = 20000;
+  static const int MAX_BANDS = 0xFFFF;
+
+  WorkerPool();
+  ~WorkerPool();
+
+  VarList * getSettings();
+
+  /// number of threads working on a job, including the caller of run()
+  int getConcurrency() const;
+
+  /// runs job(band) for every band in [0,bands) and blocks until all of them are done.
+  /// \p bands must not exceed MAX_BANDS.
+  void run(const std::string & name, int bands, const std::function<void(int)> & job);
+
+  /// duration of each band of the last job in microseconds
+  const std::vector<double> & getBandTimes() const;
+
+  /// splits [0,n) into \p parts contiguous ranges whose sizes differ by at most one
+  static void splitRange(int n, int parts, int part, int & begin, int & end);
+};
+
+#endif